@@ -10,7 +10,7 @@ using database::sqlite::Connection;
 using database::sqlite::Statement;
 
 void Main() {
-  SequenceReader reader("/data/all.speechtext");
+  SequenceReader reader("/data/all.speechtext", MMAP);
   Connection db("/data/speechtext.db");
 
   db("begin");
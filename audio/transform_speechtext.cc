@@ -12,7 +12,8 @@ struct SpeechTextTransformer : SpeechTextVisitor {
   size_t count = 0;
 
   SpeechTextTransformer()
-      : good_written(R"(^(\<i\>)?[-A-Za-z0-9 \.\,\?\'\!\"\n]+(\<\/i\>)?$)") {}
+      : good_written(R"(^(\<i\>)?[-A-Za-z0-9 \.\,\?\'\!\"\n]+(\<\/i\>)?$)",
+                     0, Regex::JIT) {}
 
   bool operator()(int64 id, string_view written, const Wave& spoken) override {
     if (!good_written.Matches(written)) return true;
@@ -0,0 +1,61 @@
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+#include "main/noargs.h"
+#include "cm/api.h"
+#include "cm/context.h"
+#include "cm/debug_allocator.h"
+#include "cm/lang_test_code.h"
+#include "cm/library.h"
+#include "cm/pool_allocator.h"
+#include "cm/state.h"
+
+using namespace cm;
+
+constexpr int kRounds = 200;
+
+// Each timing is the best of this many runs.
+constexpr int kRuns = 3;
+
+// Runs the language tests kRounds times, each in a fresh State constructed
+// from allocators, and returns the best time per round in microseconds.
+template <typename... Allocators>
+float64 MicrosPerRound(Allocators&... allocators) {
+  float64 best = std::numeric_limits<float64>::infinity();
+  for (int run = 0; run < kRuns; run++) {
+    const float64 start = now_secs();
+    for (int round = 0; round < kRounds; round++) {
+      State state(allocators...);
+      Context context(state);
+      InstallStandardLibrary();
+      LoadFromString(kLangTestCode);
+      Call(0, 0);
+    }
+    best = std::min(best, now_secs() - start);
+  }
+  return best * 1e6 / kRounds;
+}
+
+void Main() {
+  const float64 with_malloc = MicrosPerRound();
+  std::cout << "lang tests malloc: " << with_malloc << " us" << std::endl;
+
+  PoolAllocator pool_allocator;
+  const float64 with_pool = MicrosPerRound(pool_allocator);
+  std::cout << "lang tests pool: " << with_pool << " us ("
+            << with_malloc / with_pool << "x)" << std::endl;
+
+  DebugAllocator debug_allocator;
+  const float64 with_debug = MicrosPerRound(debug_allocator);
+  std::cout << "lang tests debug: " << with_debug << " us ("
+            << with_malloc / with_debug << "x)" << std::endl;
+
+  const char* const kPurposes[] = {"string",   "table",  "function",
+                                   "userdata", "thread", "other"};
+  for (int purpose = 0; purpose < PoolAllocator::kNumPurposes; purpose++)
+    std::cout << "pool high water " << kPurposes[purpose] << ": "
+              << pool_allocator.usage(Allocator::BlockPurpose(purpose))
+                     .high_water_bytes
+              << " bytes" << std::endl;
+}
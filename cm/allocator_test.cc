@@ -1,6 +1,13 @@
 #include "testing.h"
 
+#include <cstring>
+
+#include "cm/api.h"
+#include "cm/context.h"
 #include "cm/debug_allocator.h"
+#include "cm/lang_test_code.h"
+#include "cm/library.h"
+#include "cm/pool_allocator.h"
 #include "cm/state.h"
 
 namespace {
@@ -10,6 +17,71 @@ void Smoke() {
   cm::State state(debug_allocator);
 }
 
+void PoolBlocks() {
+  cm::PoolAllocator allocator;
+  std::vector<std::pair<void*, size_t>> blocks;
+  for (size_t size = 1; size <= 3000; size += 7) {
+    void* block = allocator.Create(cm::Allocator::TABLE, size);
+    std::memset(block, size % 256, size);
+    blocks.emplace_back(block, size);
+  }
+  MUST_GT(allocator.usage(cm::Allocator::TABLE).live_bytes, 0u);
+  MUST_EQ(allocator.usage(cm::Allocator::STRING).live_bytes, 0u);
+
+  // Within and across size classes, and between pooled and large blocks.
+  for (auto& block : blocks) {
+    const size_t new_size = block.second * 3 / 2 + 1;
+    block.first = allocator.Resize(block.first, block.second, new_size);
+    for (size_t i = 0; i < block.second; i++)
+      MUST_EQ(static_cast<uint8*>(block.first)[i], block.second % 256);
+    block.second = new_size;
+  }
+  const size_t high_water =
+      allocator.usage(cm::Allocator::TABLE).high_water_bytes;
+  for (const auto& block : blocks) allocator.Destroy(block.first, block.second);
+  MUST_EQ(allocator.usage(cm::Allocator::TABLE).live_bytes, 0u);
+  MUST_EQ(allocator.usage(cm::Allocator::TABLE).high_water_bytes, high_water);
+
+  // Freed blocks are reused.
+  void* block = allocator.Create(cm::Allocator::TABLE, 40);
+  allocator.Destroy(block, 40);
+  MUST_EQ(allocator.Create(cm::Allocator::TABLE, 33), block);
+  allocator.Destroy(block, 33);
+
+  // Zero-size blocks come from the smallest class, and can grow.
+  void* empty = allocator.Create(cm::Allocator::TABLE, 0);
+  void* other = allocator.Create(cm::Allocator::TABLE, 0);
+  MUST_NE(empty, other);
+  allocator.Destroy(other, 0);
+  MUST_EQ(allocator.Create(cm::Allocator::TABLE, 16), other);
+  empty = allocator.Resize(empty, 0, 8);
+  empty = allocator.Resize(empty, 8, 0);
+  allocator.Destroy(empty, 0);
+  allocator.Destroy(other, 16);
+  MUST_EQ(allocator.usage(cm::Allocator::TABLE).live_bytes, 0u);
+}
+
+void PoolState() {
+  cm::PoolAllocator allocator;
+  {
+    cm::State state(allocator);
+    cm::Context context(state);
+    cm::InstallStandardLibrary();
+    cm::LoadFromString(cm::kLangTestCode);
+    cm::Call(0, 0);
+    MUST_GT(allocator.usage(cm::Allocator::STRING).live_bytes, 0u);
+    MUST_GT(allocator.usage(cm::Allocator::TABLE).live_bytes, 0u);
+  }
+  for (int purpose = 0; purpose < cm::PoolAllocator::kNumPurposes; purpose++)
+    MUST_EQ(allocator.usage(cm::Allocator::BlockPurpose(purpose)).live_bytes,
+            0u);
+  MUST_GT(allocator.usage(cm::Allocator::FUNCTION).high_water_bytes, 0u);
+}
+
 }  // namespace
 
-void TestMain() { Smoke(); }
+void TestMain() {
+  Smoke();
+  PoolBlocks();
+  PoolState();
+}
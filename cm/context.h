@@ -21,6 +21,9 @@ using Float = State::Float;
 using CFunction = State::CFunction;
 using Index = State::Index;
 using ChunkFormat = State::ChunkFormat;
+using Dispatch = State::Dispatch;
+using GCMode = State::GCMode;
+using GCStats = State::GCStats;
 
 inline Index UPVALUE(int i);
 
@@ -111,6 +114,11 @@ inline void GCStep();
 inline bool GCSetPause(bool pause);
 inline void GCSetStepMultiplier(int step_multiplier);
 inline bool GCIsRunning();
+inline GCMode GCSetMode(GCMode mode);
+inline GCStats GCGetStats();
+
+// interpreter dispatch
+inline bool SetDispatch(Dispatch dispatch);
 
 // global table
 inline void PushGlobalTable();
@@ -123,6 +131,8 @@ inline void PushUservalue(Index userdata_index);
 inline void PopField(Index table, bool raw = false);
 inline void PushField(Index table, bool raw = false);
 [[gnu::warn_unused_result]] inline bool Next(Index table);
+inline void PopRawField(Index table, Integer key);
+inline Type PushRawField(Index table, Integer key);
 
 // metatable
 inline void PopMetatable(Index index);
@@ -292,6 +302,14 @@ inline void GCSetStepMultiplier(int step_multiplier) {
   Context::Current()->GCSetStepMultiplier(step_multiplier);
 }
 inline bool GCIsRunning() { return Context::Current()->GCIsRunning(); }
+inline GCMode GCSetMode(GCMode mode) {
+  return Context::Current()->GCSetMode(mode);
+}
+inline GCStats GCGetStats() { return Context::Current()->GCGetStats(); }
+
+inline bool SetDispatch(Dispatch dispatch) {
+  return Context::Current()->SetDispatch(dispatch);
+}
 
 // global table
 inline void PushGlobalTable() { Context::Current()->PushGlobalTable(); }
@@ -314,6 +332,12 @@ inline void PushField(Index table, bool raw) {
 [[gnu::warn_unused_result]] inline bool Next(Index table) {
   return Context::Current()->Next(table);
 }
+inline void PopRawField(Index table, Integer key) {
+  Context::Current()->PopRawField(table, key);
+}
+inline Type PushRawField(Index table, Integer key) {
+  return Context::Current()->PushRawField(table, key);
+}
 
 // metatable
 inline void PopMetatable(Index index) {
@@ -0,0 +1,117 @@
+#include "cm/pool_allocator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "core/must.h"
+
+namespace cm {
+
+PoolAllocator::~PoolAllocator() {
+  for (Pool& pool : pools_) {
+    MUST_EQ(pool.usage.live_bytes, 0u);
+    while (pool.slabs) {
+      Slab* next = pool.slabs->next;
+      std::free(pool.slabs);
+      pool.slabs = next;
+    }
+  }
+}
+
+void* PoolAllocator::Create(BlockPurpose block_purpose, size_t size) {
+  Pool& pool = pools_[block_purpose];
+  if (IsPooled(size)) {
+    void* block = CreatePooled(pool, block_purpose, size);
+    Add(pool, size);
+    return block;
+  }
+  auto header = static_cast<LargeHeader*>(
+      std::malloc(sizeof(LargeHeader) + size));
+  if (header == nullptr) throw std::bad_alloc();
+  header->purpose = block_purpose;
+  Add(pool, size);
+  return header + 1;
+}
+
+void* PoolAllocator::Resize(void* old_block, size_t old_size,
+                            size_t new_size) {
+  const BlockPurpose purpose = PurposeOf(old_block, old_size);
+  Pool& pool = pools_[purpose];
+  if (IsPooled(old_size) && IsPooled(new_size) &&
+      SizeClass(old_size) == SizeClass(new_size)) {
+    Remove(pool, old_size);
+    Add(pool, new_size);
+    return old_block;
+  }
+  if (!IsPooled(old_size) && !IsPooled(new_size)) {
+    auto header = static_cast<LargeHeader*>(std::realloc(
+        static_cast<LargeHeader*>(old_block) - 1,
+        sizeof(LargeHeader) + new_size));
+    if (header == nullptr) throw std::bad_alloc();
+    Remove(pool, old_size);
+    Add(pool, new_size);
+    return header + 1;
+  }
+  void* new_block = Create(purpose, new_size);
+  std::memcpy(new_block, old_block, std::min(old_size, new_size));
+  Destroy(old_block, old_size);
+  return new_block;
+}
+
+void PoolAllocator::Destroy(void* block, size_t old_size) {
+  Pool& pool = pools_[PurposeOf(block, old_size)];
+  Remove(pool, old_size);
+  if (IsPooled(old_size))
+    DestroyPooled(pool, block, old_size);
+  else
+    std::free(static_cast<LargeHeader*>(block) - 1);
+}
+
+Allocator::BlockPurpose PoolAllocator::PurposeOf(void* block, size_t size) {
+  if (!IsPooled(size)) return (static_cast<LargeHeader*>(block) - 1)->purpose;
+  const uintptr_t slab =
+      reinterpret_cast<uintptr_t>(block) & ~uintptr_t(kSlabSize - 1);
+  return reinterpret_cast<Slab*>(slab)->purpose;
+}
+
+void* PoolAllocator::CreatePooled(Pool& pool, BlockPurpose purpose,
+                                  size_t size) {
+  const int size_class = SizeClass(size);
+  FreeBlock*& head = pool.free[size_class];
+  if (head) {
+    FreeBlock* block = head;
+    head = block->next;
+    return block;
+  }
+  const size_t class_size = (size_class + 1) * kGranularity;
+  if (size_t(pool.bump_end - pool.bump) < class_size) Grow(pool, purpose);
+  void* block = pool.bump;
+  pool.bump += class_size;
+  return block;
+}
+
+void PoolAllocator::DestroyPooled(Pool& pool, void* block, size_t size) {
+  FreeBlock*& head = pool.free[SizeClass(size)];
+  head = new (block) FreeBlock{head};
+}
+
+// The unused end of the current slab is abandoned.
+void PoolAllocator::Grow(Pool& pool, BlockPurpose purpose) {
+  void* memory;
+  if (posix_memalign(&memory, kSlabSize, kSlabSize) != 0)
+    throw std::bad_alloc();
+  pool.slabs = new (memory) Slab{purpose, pool.slabs};
+  pool.bump = static_cast<char*>(memory) + sizeof(Slab);
+  pool.bump_end = static_cast<char*>(memory) + kSlabSize;
+}
+
+void PoolAllocator::Add(Pool& pool, size_t size) {
+  pool.usage.live_bytes += size;
+  if (pool.usage.live_bytes > pool.usage.high_water_bytes)
+    pool.usage.high_water_bytes = pool.usage.live_bytes;
+}
+
+}  // namespace cm
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "cm/allocator.h"
+
+namespace cm {
+
+// Serves small blocks from per-purpose slabs, with a free list per size
+// class, and larger blocks from malloc. Not thread-safe: a PoolAllocator
+// must only be used by the thread running its States.
+class PoolAllocator : public Allocator {
+ public:
+  static constexpr int kNumPurposes = OTHER + 1;
+
+  // Requested bytes, not counting size class rounding or slab overhead.
+  struct Usage {
+    size_t live_bytes = 0;
+    size_t high_water_bytes = 0;
+  };
+
+  PoolAllocator() = default;
+  PoolAllocator(const PoolAllocator&) = delete;
+  PoolAllocator& operator=(const PoolAllocator&) = delete;
+  ~PoolAllocator();
+
+  void* Create(BlockPurpose block_purpose, size_t size) override;
+
+  void* Resize(void* old_block, size_t old_size, size_t new_size) override;
+
+  void Destroy(void* block, size_t old_size) override;
+
+  const Usage& usage(BlockPurpose block_purpose) const {
+    return pools_[block_purpose].usage;
+  }
+
+ private:
+  static constexpr size_t kGranularity = 16;
+  static constexpr size_t kMaxPooledSize = 1024;
+  static constexpr int kNumClasses = kMaxPooledSize / kGranularity;
+  static constexpr size_t kSlabSize = 64 * 1024;
+
+  // Starts every slab, which is aligned to kSlabSize so that a block's slab
+  // can be found from its address.
+  struct alignas(kGranularity) Slab {
+    BlockPurpose purpose;
+    Slab* next;
+  };
+
+  // Starts every block larger than kMaxPooledSize.
+  struct alignas(kGranularity) LargeHeader {
+    BlockPurpose purpose;
+  };
+
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  struct Pool {
+    FreeBlock* free[kNumClasses] = {};
+    Slab* slabs = nullptr;
+    char* bump = nullptr;
+    char* bump_end = nullptr;
+    Usage usage;
+  };
+
+  static bool IsPooled(size_t size) { return size <= kMaxPooledSize; }
+
+  // Zero-size blocks share the smallest class, so that each is distinct.
+  static int SizeClass(size_t size) {
+    return size == 0 ? 0 : int((size - 1) / kGranularity);
+  }
+
+  static BlockPurpose PurposeOf(void* block, size_t size);
+
+  void* CreatePooled(Pool& pool, BlockPurpose purpose, size_t size);
+
+  void DestroyPooled(Pool& pool, void* block, size_t size);
+
+  void Grow(Pool& pool, BlockPurpose purpose);
+
+  static void Add(Pool& pool, size_t size);
+
+  static void Remove(Pool& pool, size_t size) {
+    pool.usage.live_bytes -= size;
+  }
+
+  Pool pools_[kNumPurposes];
+};
+
+}  // namespace cm
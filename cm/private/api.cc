@@ -997,6 +997,12 @@ LUA_API int lua_gc(lua_State *L, int what, int data) {
       res = g->gcrunning;
       break;
     }
+    case LUA_GCINC:
+    case LUA_GCGEN: { /* returns the previous mode */
+      res = isgenerational(g) ? LUA_GCGEN : LUA_GCINC;
+      luaC_changemode(L, what == LUA_GCGEN);
+      break;
+    }
     default:
       res = -1; /* invalid option */
   }
@@ -1004,6 +1010,25 @@ LUA_API int lua_gc(lua_State *L, int what, int data) {
   return res;
 }
 
+LUA_API void lua_gcstats(lua_State *L, lua_GCStats *stats) {
+  lua_lock(L);
+  *stats = G(L)->gcstats;
+  lua_unlock(L);
+}
+
+/*
+** Chooses how the interpreter loop dispatches instructions.  Returns 0,
+** leaving the mode alone, if it is not available in this build.
+*/
+LUA_API int lua_setdispatch(lua_State *L, int mode) {
+  if (mode == LUA_DISPATCHJUMPTABLE && !LUA_USE_JUMPTABLE) return 0;
+  if (mode != LUA_DISPATCHSWITCH && mode != LUA_DISPATCHJUMPTABLE) return 0;
+  lua_lock(L);
+  G(L)->dispatch = cast_byte(mode);
+  lua_unlock(L);
+  return 1;
+}
+
 /*
 ** miscellaneous functions
 */
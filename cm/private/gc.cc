@@ -5,6 +5,8 @@
 
 #include <string.h>
 
+#include <chrono>
+
 #include "cm/private/lua.h"
 
 #include "cm/private/debug.h"
@@ -49,10 +51,10 @@
 #define PAUSEADJ 100
 
 /*
-** 'makewhite' erases all color bits then sets only the current white
-** bit
+** 'makewhite' erases all color bits and the old bit, then sets only the
+** current white bit
 */
-#define maskcolors (~(bitmask(BLACKBIT) | WHITEBITS))
+#define maskcolors (~(bit2mask(BLACKBIT, OLDBIT) | WHITEBITS))
 #define makewhite(g, x) \
   (x->marked = cast_byte((x->marked & maskcolors) | luaC_white(g)))
 
@@ -348,7 +350,7 @@ static void traverseweakvalue(global_State *g, Table *h) {
   }
   if (g->gcstate == GCSpropagate)
     linkgclist(h, g->grayagain); /* must retraverse it in atomic phase */
-  else if (hasclears)
+  else if (hasclears || isgenerational(g))
     linkgclist(h, g->weak); /* has to be cleared later */
 }
 
@@ -394,8 +396,8 @@ static int traverseephemeron(global_State *g, Table *h) {
     linkgclist(h, g->grayagain); /* must retraverse it in atomic phase */
   else if (hasww)                /* table has white->white entries? */
     linkgclist(h, g->ephemeron); /* have to propagate again */
-  else if (hasclears)            /* table has white keys? */
-    linkgclist(h, g->allweak);   /* may have to clean white keys */
+  else if (hasclears || isgenerational(g)) /* table has white keys? */
+    linkgclist(h, g->allweak); /* may have to clean white keys */
   return marked;
 }
 
@@ -628,6 +630,22 @@ static void clearvalues(global_State *g, GCObject *l, GCObject *f) {
   }
 }
 
+/*
+** In generational mode, old weak tables are not traversed again unless
+** they are in a gray list, so after the atomic phase move every weak
+** table into 'grayagain' to have it cleared by the next collection too.
+*/
+static void retraverseweak(global_State *g) {
+  GCObject **lists[] = {&g->weak, &g->allweak, &g->ephemeron};
+  for (GCObject **l : lists) {
+    while (*l != NULL) {
+      Table *h = gco2t(*l);
+      *l = h->gclist;
+      linkgclist(h, g->grayagain);
+    }
+  }
+}
+
 void luaC_upvdeccount(lua_State *L, UpVal *uv) {
   lua_assert(uv->refcount > 0);
   uv->refcount--;
@@ -685,21 +703,32 @@ static GCObject **sweeplist(lua_State *L, GCObject **p, lu_mem count);
 ** sweep at most 'count' elements from a list of GCObjects erasing dead
 ** objects, where a dead object is one marked with the old (non current)
 ** white; change all non-dead objects back to white, preparing for next
-** collection cycle. Return where to continue the traversal or NULL if
-** list is finished.
+** collection cycle. In generational mode, instead mark survivors old and
+** stop at the first old object, as everything after it is old too. Return
+** where to continue the traversal or NULL if list is finished.
 */
 static GCObject **sweeplist(lua_State *L, GCObject **p, lu_mem count) {
   global_State *g = G(L);
   int ow = otherwhite(g);
-  int white = luaC_white(g); /* current white */
+  int toclear, toset, tostop;
+  if (isgenerational(g)) {
+    toclear = ~0;             /* keep colors */
+    toset = bitmask(OLDBIT);  /* survivors are old */
+    tostop = bitmask(OLDBIT); /* do not sweep the old generation */
+  } else {
+    toclear = maskcolors;
+    toset = luaC_white(g); /* current white */
+    tostop = 0;
+  }
   while (*p != NULL && count-- > 0) {
     GCObject *curr = *p;
     int marked = curr->marked;
     if (isdeadm(ow, marked)) { /* is 'curr' dead? */
       *p = curr->next;         /* remove 'curr' from list */
       freeobj(L, curr);        /* erase 'curr' */
-    } else {                   /* change mark to 'white' */
-      curr->marked = cast_byte((marked & maskcolors) | white);
+    } else {
+      if (testbits(marked, tostop)) return NULL; /* rest of list is old */
+      curr->marked = cast_byte((marked & toclear) | toset);
       p = &curr->next; /* go to next element */
     }
   }
@@ -748,6 +777,7 @@ static GCObject *udata2finalize(global_State *g) {
   o->next = g->allgc;   /* return it to 'allgc' list */
   g->allgc = o;
   resetbit(o->marked, FINALIZEDBIT);    /* object is "normal" again */
+  resetoldbit(o); /* objects at the head of a list must be young */
   if (issweepphase(g)) makewhite(g, o); /* "sweep" object */
   return o;
 }
@@ -832,6 +862,7 @@ static void separatetobefnz(global_State *g, int all) {
       p = &curr->next;           /* don't bother with it */
     else {
       *p = curr->next;        /* remove 'curr' from 'finobj' list */
+      resetoldbit(curr);      /* 'tobefnz' holds no old objects */
       curr->next = *lastnext; /* link at the end of 'tobefnz' list */
       *lastnext = curr;
       lastnext = &curr->next;
@@ -862,6 +893,7 @@ void luaC_checkfinalizer(lua_State *L, GCObject *o, Table *mt) {
     o->next = g->finobj; /* link it in 'finobj' list */
     g->finobj = o;
     l_setbit(o->marked, FINALIZEDBIT); /* mark it as such */
+    resetoldbit(o); /* objects at the head of a list must be young */
   }
 }
 
@@ -915,6 +947,7 @@ void luaC_freeallobjects(lua_State *L) {
   lua_assert(g->tobefnz == NULL);
   g->currentwhite = WHITEBITS; /* this "white" makes all objects look dead */
   g->gckind = KGC_NORMAL;
+  g->gcgen = 0; /* sweep old objects too */
   sweepwholelist(L, &g->finobj);
   sweepwholelist(L, &g->allgc);
   sweepwholelist(L, &g->fixedgc); /* collect fixed objects */
@@ -926,6 +959,7 @@ static l_mem atomic(lua_State *L) {
   l_mem work;
   GCObject *origweak, *origall;
   GCObject *grayagain = g->grayagain; /* save original list */
+  g->grayagain = NULL; /* objects traversed here may be linked again */
   lua_assert(g->ephemeron == NULL && g->weak == NULL);
   lua_assert(!iswhite(g->mainthread));
   g->gcstate = GCSinsideatomic;
@@ -963,6 +997,7 @@ static l_mem atomic(lua_State *L) {
   clearvalues(g, g->weak, origweak);
   clearvalues(g, g->allweak, origall);
   luaS_clearcache(g);
+  if (isgenerational(g)) retraverseweak(g);
   g->currentwhite = cast_byte(otherwhite(g)); /* flip current white */
   work += g->GCmemtrav;                       /* complete counting */
   return work; /* estimate of memory marked by 'atomic' */
@@ -974,6 +1009,7 @@ static lu_mem sweepstep(lua_State *L, global_State *g, int nextstate,
     l_mem olddebt = g->GCdebt;
     g->sweepgc = sweeplist(L, g->sweepgc, GCSWEEPMAX);
     g->GCestimate += g->GCdebt - olddebt; /* update estimate */
+    g->gcstats.freedbytes += olddebt - g->GCdebt;
     if (g->sweepgc) /* is there still something to sweep? */
       return (GCSWEEPMAX * GCSWEEPCOST);
   }
@@ -994,8 +1030,8 @@ static lu_mem singlestep(lua_State *L) {
     }
     case GCSpropagate: {
       g->GCmemtrav = 0;
-      lua_assert(g->gray);
-      propagatemark(g);
+      /* a minor collection may start with nothing to propagate */
+      if (g->gray) propagatemark(g);
       if (g->gray == NULL)      /* no more gray objects? */
         g->gcstate = GCSatomic; /* finish propagate phase */
       return g->GCmemtrav;      /* memory traversed in this step */
@@ -1019,8 +1055,9 @@ static lu_mem singlestep(lua_State *L) {
     case GCSswptobefnz: { /* sweep objects to be finalized */
       return sweepstep(L, g, GCSswpend, NULL);
     }
-    case GCSswpend: {              /* finish sweeps */
-      makewhite(g, g->mainthread); /* sweep main thread */
+    case GCSswpend: { /* finish sweeps */
+      if (!isgenerational(g))
+        makewhite(g, g->mainthread); /* sweep main thread */
       checkSizes(L, g);
       g->gcstate = GCScallfin;
       return 0;
@@ -1062,28 +1099,116 @@ static l_mem getdebt(global_State *g) {
 }
 
 /*
-** performs a basic GC step when collector is running
+** In generational mode the collector rests in the propagate state
+** between collections. Objects that survived a collection are old and
+** stay marked, so the barriers keep the invariant, and what they mark or
+** link into 'gray' and 'grayagain' (old tables that were changed), along
+** with every thread and weak table, is the remembered set. A minor
+** collection traverses only that and the young objects it reaches, and
+** its sweeps stop at the first old object of each list, as objects are
+** always linked young at the heads of lists.
 */
-void luaC_step(lua_State *L) {
-  global_State *g = G(L);
-  l_mem debt = getdebt(g);             /* GC deficit (be paid now) */
-  if (!g->gcrunning) {                 /* not running? */
-    luaE_setdebt(g, -GCSTEPSIZE * 10); /* avoid being called too often */
-    return;
-  }
+
+static void setminordebt(global_State *g) {
+  luaE_setdebt(g, -CAST(l_mem, (gettotalbytes(g) / 100) * LUAI_GENMINORMUL));
+}
+
+/*
+** Mark every surviving object old, starting from a heap with no marked
+** objects. 'GCestimate' keeps what survived, to decide when to run the
+** next major collection.
+*/
+static void entergen(lua_State *L, global_State *g) {
+  luaC_runtilstate(L, bitmask(GCSpause)); /* finish any cycle */
+  g->gcgen = 1;
+  luaC_runtilstate(L, bitmask(GCSpropagate)); /* mark roots */
+  luaC_runtilstate(L, bitmask(GCSpause));     /* whole cycle */
+  g->gcstate = GCSpropagate; /* keep gray lists: do not restart */
+  g->GCestimate = gettotalbytes(g);
+  setminordebt(g);
+}
+
+/*
+** Leave generational mode, sweeping everything back to white. (As white
+** does not change, nothing is collected.)
+*/
+static void enterinc(lua_State *L, global_State *g) {
+  lua_assert(g->gcstate == GCSpropagate);
+  g->gcgen = 0;
+  entersweep(L);
+  luaC_runtilstate(L, bitmask(GCSpause));
+}
+
+static void majorcollection(lua_State *L, global_State *g) {
+  enterinc(L, g);
+  entergen(L, g);
+  g->gcstats.majorcollections++;
+}
+
+static void minorcollection(lua_State *L, global_State *g) {
+  lu_mem estimate = g->GCestimate; /* the cycle changes it */
+  lua_assert(g->gcstate == GCSpropagate);
+  luaC_runtilstate(L, bitmask(GCSpause));
+  g->gcstate = GCSpropagate; /* keep gray lists: do not restart */
+  g->GCestimate = estimate;
+  setminordebt(g);
+  g->gcstats.minorcollections++;
+}
+
+static void genstep(lua_State *L, global_State *g) {
+  if (gettotalbytes(g) > (g->GCestimate / 100) * (100 + LUAI_GENMAJORMUL))
+    majorcollection(L, g);
+  else
+    minorcollection(L, g);
+}
+
+static double gcclock() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static void addpause(global_State *g, double start) {
+  double pause = gcclock() - start;
+  g->gcstats.pauses++;
+  g->gcstats.pausetime += pause;
+  if (pause > g->gcstats.maxpause) g->gcstats.maxpause = pause;
+}
+
+static void incstep(lua_State *L, global_State *g) {
+  l_mem debt = getdebt(g); /* GC deficit (be paid now) */
   do { /* repeat until pause or enough "credit" (negative debt) */
     lu_mem work = singlestep(L); /* perform one single step */
     debt -= work;
   } while (debt > -GCSTEPSIZE && g->gcstate != GCSpause);
-  if (g->gcstate == GCSpause)
+  if (g->gcstate == GCSpause) {
     setpause(g); /* pause until next cycle */
-  else {
+    g->gcstats.majorcollections++;
+  } else {
     debt = (debt / g->gcstepmul) * STEPMULADJ; /* convert 'work units' to Kb */
     luaE_setdebt(g, debt);
     runafewfinalizers(L);
   }
 }
 
+/*
+** performs a basic GC step when collector is running
+*/
+void luaC_step(lua_State *L) {
+  global_State *g = G(L);
+  double start;
+  if (!g->gcrunning) {                 /* not running? */
+    luaE_setdebt(g, -GCSTEPSIZE * 10); /* avoid being called too often */
+    return;
+  }
+  start = gcclock();
+  if (isgenerational(g))
+    genstep(L, g);
+  else
+    incstep(L, g);
+  addpause(g, start);
+}
+
 /*
 ** Performs a full GC cycle; if 'isemergency', set a flag to avoid
 ** some operations which could change the interpreter state in some
@@ -1095,20 +1220,46 @@ void luaC_step(lua_State *L) {
 */
 void luaC_fullgc(lua_State *L, int isemergency) {
   global_State *g = G(L);
+  double start = gcclock();
   lua_assert(g->gckind == KGC_NORMAL);
   if (isemergency) g->gckind = KGC_EMERGENCY; /* set flag */
-  if (keepinvariant(g)) {                     /* black objects? */
-    entersweep(L); /* sweep everything to turn them back to white */
+  if (isgenerational(g)) {
+    majorcollection(L, g);
+  } else {
+    if (keepinvariant(g)) { /* black objects? */
+      entersweep(L); /* sweep everything to turn them back to white */
+    }
+    /* finish any pending sweep phase to start a new cycle */
+    luaC_runtilstate(L, bitmask(GCSpause));
+    luaC_runtilstate(L, ~bitmask(GCSpause));  /* start new collection */
+    luaC_runtilstate(L, bitmask(GCScallfin)); /* run up to finalizers */
+    /* estimate must be correct after a full GC cycle */
+    lua_assert(g->GCestimate == gettotalbytes(g));
+    luaC_runtilstate(L, bitmask(GCSpause)); /* finish collection */
+    setpause(g);
+    g->gcstats.majorcollections++;
   }
-  /* finish any pending sweep phase to start a new cycle */
-  luaC_runtilstate(L, bitmask(GCSpause));
-  luaC_runtilstate(L, ~bitmask(GCSpause));  /* start new collection */
-  luaC_runtilstate(L, bitmask(GCScallfin)); /* run up to finalizers */
-  /* estimate must be correct after a full GC cycle */
-  lua_assert(g->GCestimate == gettotalbytes(g));
-  luaC_runtilstate(L, bitmask(GCSpause)); /* finish collection */
   g->gckind = KGC_NORMAL;
-  setpause(g);
+  addpause(g, start);
+}
+
+/*
+** Switches between incremental and generational modes. Entering
+** generational mode runs a full collection, to make survivors old.
+*/
+void luaC_changemode(lua_State *L, int generational) {
+  global_State *g = G(L);
+  double start;
+  if (generational == isgenerational(g)) return;
+  start = gcclock();
+  if (generational) {
+    entergen(L, g);
+    g->gcstats.majorcollections++;
+  } else {
+    enterinc(L, g);
+    setpause(g);
+  }
+  addpause(g, start);
 }
 
 /* }====================================================== */
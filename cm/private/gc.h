@@ -22,6 +22,19 @@
 #define GCSTEPSIZE (cast_int(100 * sizeof(TString)))
 #endif
 
+/*
+** In generational mode, a minor collection starts after allocating
+** GENMINORMUL% of the memory in use, and a major one once memory in use
+** has grown GENMAJORMUL% over what the last major collection left.
+*/
+#if !defined(LUAI_GENMINORMUL)
+#define LUAI_GENMINORMUL 20
+#endif
+
+#if !defined(LUAI_GENMAJORMUL)
+#define LUAI_GENMAJORMUL 100
+#endif
+
 /*
 ** Possible states of the Garbage Collector
 */
@@ -37,15 +50,18 @@
 #define issweepphase(g) \
   (GCSswpallgc <= (g)->gcstate && (g)->gcstate <= GCSswpend)
 
+#define isgenerational(g) ((g)->gcgen)
+
 /*
 ** macro to tell when main invariant (white objects cannot point to black
 ** ones) must be kept. During a collection, the sweep
 ** phase may break the invariant, as objects turned white may point to
 ** still-black objects. The invariant is restored when sweep ends and
-** all objects are white again.
+** all objects are white again. In generational mode sweeps leave
+** survivors marked, so the invariant is always kept.
 */
 
-#define keepinvariant(g) ((g)->gcstate <= GCSatomic)
+#define keepinvariant(g) (isgenerational(g) || (g)->gcstate <= GCSatomic)
 
 /*
 ** some useful bit tricks
@@ -64,6 +80,7 @@
 #define WHITE1BIT 1    /* object is white (type 1) */
 #define BLACKBIT 2     /* object is black */
 #define FINALIZEDBIT 3 /* object has been marked for finalization */
+#define OLDBIT 4       /* object is old (only in generational mode) */
 /* bit 7 is currently used by tests (luaL_checkmemory) */
 
 #define WHITEBITS bit2mask(WHITE0BIT, WHITE1BIT)
@@ -75,6 +92,9 @@
 
 #define tofinalize(x) testbit((x)->marked, FINALIZEDBIT)
 
+#define isold(x) testbit((x)->marked, OLDBIT)
+#define resetoldbit(x) resetbit((x)->marked, OLDBIT)
+
 #define otherwhite(g) ((g)->currentwhite ^ WHITEBITS)
 #define isdeadm(ow, m) (!(((m) ^ WHITEBITS) & (ow)))
 #define isdead(g, v) isdeadm(otherwhite(g), (v)->marked)
@@ -120,6 +140,7 @@ LUAI_FUNC void luaC_freeallobjects(lua_State *L);
 LUAI_FUNC void luaC_step(lua_State *L);
 LUAI_FUNC void luaC_runtilstate(lua_State *L, int statesmask);
 LUAI_FUNC void luaC_fullgc(lua_State *L, int isemergency);
+LUAI_FUNC void luaC_changemode(lua_State *L, int generational);
 LUAI_FUNC GCObject *luaC_newobj(lua_State *L, int tt, size_t sz);
 LUAI_FUNC void luaC_barrier_(lua_State *L, GCObject *o, GCObject *v);
 LUAI_FUNC void luaC_barrierback_(lua_State *L, Table *o);
@@ -269,9 +269,35 @@ LUA_API int(lua_isyieldable)(lua_State *L);
 #define LUA_GCSETPAUSE 6
 #define LUA_GCSETSTEPMUL 7
 #define LUA_GCISRUNNING 9
+#define LUA_GCINC 10
+#define LUA_GCGEN 11
 
 LUA_API int(lua_gc)(lua_State *L, int what, int data);
 
+/*
+** garbage-collection counters, accumulated since the state was created
+*/
+
+typedef struct lua_GCStats {
+  lua_Integer minorcollections; /* generational collections of young objects */
+  lua_Integer majorcollections; /* collections of the whole heap */
+  lua_Integer pauses;           /* collector invocations, each a pause */
+  lua_Number pausetime;         /* seconds spent in the collector */
+  lua_Number maxpause;          /* seconds of the longest pause */
+  lua_Integer freedbytes;       /* bytes freed by sweeping */
+} lua_GCStats;
+
+LUA_API void(lua_gcstats)(lua_State *L, lua_GCStats *stats);
+
+/*
+** interpreter dispatch modes
+*/
+
+#define LUA_DISPATCHSWITCH 0
+#define LUA_DISPATCHJUMPTABLE 1
+
+LUA_API int(lua_setdispatch)(lua_State *L, int mode);
+
 /*
 ** miscellaneous functions
 */
@@ -53,6 +53,19 @@
 // #define LUA_USE_READLINE /* needs some extra libraries */
 #endif
 
+/*
+@@ LUA_USE_JUMPTABLE makes the interpreter loop dispatch through a table
+** of label addresses (a GNU extension, also in Clang) instead of a switch.
+** Define it as 0 to build with the switch only.
+*/
+#if !defined(LUA_USE_JUMPTABLE)
+#if defined(__GNUC__)
+#define LUA_USE_JUMPTABLE 1
+#else
+#define LUA_USE_JUMPTABLE 0
+#endif
+#endif
+
 #if defined(LUA_USE_MACOSX)
 #define LUA_USE_POSIX
 #define LUA_USE_DLOPEN   /* MacOS does not need -ldl */
@@ -286,6 +286,8 @@ LUA_API lua_State *lua_newstate(lua_Alloc f, void *ud) {
   g->version = NULL;
   g->gcstate = GCSpause;
   g->gckind = KGC_NORMAL;
+  g->gcgen = 0;
+  g->dispatch = LUA_USE_JUMPTABLE ? LUA_DISPATCHJUMPTABLE : LUA_DISPATCHSWITCH;
   g->allgc = g->finobj = g->tobefnz = g->fixedgc = NULL;
   g->sweepgc = NULL;
   g->gray = g->grayagain = NULL;
@@ -296,6 +298,7 @@ LUA_API lua_State *lua_newstate(lua_Alloc f, void *ud) {
   g->gcfinnum = 0;
   g->gcpause = LUAI_GCPAUSE;
   g->gcstepmul = LUAI_GCMUL;
+  memset(&g->gcstats, 0, sizeof(g->gcstats));
   for (i = 0; i < LUA_NUMTAGS; i++) g->mt[i] = NULL;
   if (luaD_rawrunprotected(L, f_luaopen, NULL) != LUA_OK) {
     /* memory allocation error: free partial state */
@@ -103,7 +103,9 @@ typedef struct global_State {
   lu_byte currentwhite;
   lu_byte gcstate;         /* state of garbage collector */
   lu_byte gckind;          /* kind of GC running */
+  lu_byte gcgen;           /* true if GC is in generational mode */
   lu_byte gcrunning;       /* true if GC is running */
+  lu_byte dispatch;        /* dispatch mode of the interpreter loop */
   GCObject *allgc;         /* list of all collectable objects */
   GCObject **sweepgc;      /* current position of sweep in list */
   GCObject *finobj;        /* list of collectable objects with finalizers */
@@ -119,6 +121,7 @@ typedef struct global_State {
   unsigned int gcfinnum;   /* number of finalizers to call in each GC step */
   int gcpause;             /* size of pause between successive GCs */
   int gcstepmul;           /* GC 'granularity' */
+  lua_GCStats gcstats;     /* pause and throughput counters */
   lua_CFunction panic;     /* to be called in unprotected errors */
   struct lua_State *mainthread;
   const lua_Number *version;           /* pointer to version number */
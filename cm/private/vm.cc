@@ -696,12 +696,21 @@ void luaV_finishOp(lua_State *L) {
 #define KBx(i) \
   (k + (GETARG_Bx(i) != 0 ? GETARG_Bx(i) - 1 : GETARG_Ax(*ci->u.l.savedpc++)))
 
+/*
+** 'trap' caches whether line or count hooks are on, so that the loop only
+** tests a local per instruction.  It is refreshed wherever the hooks could
+** have changed: after anything that may run other code, and on jumps, so
+** that a hook set from outside is noticed by the next loop iteration.
+*/
+#define updatetrap() (trap = L->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT))
+
 /* execute a jump instruction */
 #define dojump(ci, i, e)                            \
   {                                                 \
     int a = GETARG_A(i);                            \
     if (a > 0) luaF_close(L, ci->u.l.base + a - 1); \
     ci->u.l.savedpc += GETARG_sBx(i) + e;           \
+    updatetrap();                                   \
   }
 
 /* for test instructions, execute the jump instruction that follows it */
@@ -715,6 +724,7 @@ void luaV_finishOp(lua_State *L) {
   {                      \
     { x; };              \
     base = ci->u.l.base; \
+    updatetrap();        \
   }
 
 #define checkGC(L, c)                        \
@@ -726,26 +736,81 @@ void luaV_finishOp(lua_State *L) {
                       }) /* restore top */   \
           luai_threadyield(L);)
 
+/*
+** With kJumpTable each instruction ends by fetching the next one and
+** jumping straight to its code through 'disptab', which gives every opcode
+** its own indirect branch to predict.  The copies are kept to a few
+** instructions, leaving the hooks to the top of the loop, and GCC's cross
+** jumping, which would merge them back into one, is turned off.  Otherwise
+** it goes back round to the switch.
+*/
+#if LUA_USE_JUMPTABLE
+#if defined(__GNUC__) && !defined(__clang__)
+#define l_dispatchopt __attribute__((optimize("no-crossjumping")))
+#else
+#define l_dispatchopt
+#endif
+#define vmdispatch(o)               \
+  if (kJumpTable) goto *disptab[o]; \
+  switch (o)
+#define vmcase(l) \
+  case l:         \
+  L_##l:
+#define vmbreak                   \
+  if (kJumpTable) {               \
+    i = *(ci->u.l.savedpc++);     \
+    if (trap) goto hook;          \
+    ra = RA(i);                   \
+    goto *disptab[GET_OPCODE(i)]; \
+  }                               \
+  break
+#else
 #define vmdispatch(o) switch (o)
 #define vmcase(l) case l:
 #define vmbreak break
+#define l_dispatchopt
+#endif
 
-void luaV_execute(lua_State *L) {
+template <bool kJumpTable>
+l_dispatchopt static void execute(lua_State *L) {
+#if LUA_USE_JUMPTABLE
+  /* in the order of 'OpCode' */
+  static const void *const disptab[] = {
+      &&L_OP_MOVE,     &&L_OP_LOADK,    &&L_OP_LOADKX,   &&L_OP_LOADBOOL,
+      &&L_OP_LOADNIL,  &&L_OP_GETUPVAL, &&L_OP_GETTABUP, &&L_OP_GETTABLE,
+      &&L_OP_SETTABUP, &&L_OP_SETUPVAL, &&L_OP_SETTABLE, &&L_OP_NEWTABLE,
+      &&L_OP_SELF,     &&L_OP_ADD,      &&L_OP_SUB,      &&L_OP_MUL,
+      &&L_OP_MOD,      &&L_OP_DIV,      &&L_OP_BAND,     &&L_OP_BOR,
+      &&L_OP_BXOR,     &&L_OP_SHL,      &&L_OP_SHR,      &&L_OP_UNM,
+      &&L_OP_BNOT,     &&L_OP_NOT,      &&L_OP_LEN,      &&L_OP_CONCAT,
+      &&L_OP_JMP,      &&L_OP_EQ,       &&L_OP_LT,       &&L_OP_LE,
+      &&L_OP_TEST,     &&L_OP_TESTSET,  &&L_OP_CALL,     &&L_OP_TAILCALL,
+      &&L_OP_RETURN,   &&L_OP_FORLOOP,  &&L_OP_FORPREP,  &&L_OP_TFORCALL,
+      &&L_OP_TFORLOOP, &&L_OP_SETLIST,  &&L_OP_CLOSURE,  &&L_OP_VARARG,
+      &&L_OP_EXTRAARG,
+  };
+  static_assert(sizeof(disptab) / sizeof(disptab[0]) == NUM_OPCODES,
+                "disptab must have an entry for every opcode");
+#endif
   CallInfo *ci = L->ci;
   LClosure *cl;
   TValue *k;
   StkId base;
+  int trap;
 newframe: /* reentry point when frame changes (call/return) */
   lua_assert(ci == L->ci);
   cl = clLvalue(ci->func);
   k = cl->p->k;
   base = ci->u.l.base;
+  updatetrap();
   /* main loop of interpreter */
   for (;;) {
     Instruction i = *(ci->u.l.savedpc++);
     StkId ra;
-    if ((L->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT)) &&
-        (--L->hookcount == 0 || L->hookmask & LUA_MASKLINE)) {
+#if LUA_USE_JUMPTABLE
+  hook:
+#endif
+    if (trap && (--L->hookcount == 0 || L->hookmask & LUA_MASKLINE)) {
       Protect(luaG_traceexec(L));
     }
     /* WARNING: several calls may realloc the stack and invalidate 'ra' */
@@ -1058,6 +1123,7 @@ newframe: /* reentry point when frame changes (call/return) */
         if (luaD_precall(L, ra, nresults)) {   /* C function? */
           if (nresults >= 0) L->top = ci->top; /* adjust results */
           base = ci->u.l.base;
+          updatetrap();
         } else { /* Lua function */
           ci = L->ci;
           ci->callstatus |= CIST_REENTRY;
@@ -1069,9 +1135,10 @@ newframe: /* reentry point when frame changes (call/return) */
         int b = GETARG_B(i);
         if (b != 0) L->top = ra + b; /* else previous instruction set top */
         lua_assert(GETARG_C(i) - 1 == LUA_MULTRET);
-        if (luaD_precall(L, ra, LUA_MULTRET)) /* C function? */
+        if (luaD_precall(L, ra, LUA_MULTRET)) { /* C function? */
           base = ci->u.l.base;
-        else {
+          updatetrap();
+        } else {
           /* tail call: put called frame (n) in place of caller one (o) */
           CallInfo *nci = L->ci;         /* called frame */
           CallInfo *oci = nci->previous; /* caller frame */
@@ -1118,6 +1185,7 @@ newframe: /* reentry point when frame changes (call/return) */
             ci->u.l.savedpc += GETARG_sBx(i); /* jump back */
             chgivalue(ra, idx);               /* update internal index... */
             setivalue(ra + 3, idx);           /* ...and external index */
+            updatetrap();
           }
         } else { /* floating loop */
           lua_Number step = fltvalue(ra + 2);
@@ -1128,6 +1196,7 @@ newframe: /* reentry point when frame changes (call/return) */
             ci->u.l.savedpc += GETARG_sBx(i); /* jump back */
             chgfltvalue(ra, idx);             /* update internal index... */
             setfltvalue(ra + 3, idx);         /* ...and external index */
+            updatetrap();
           }
         }
         vmbreak;
@@ -1179,6 +1248,7 @@ newframe: /* reentry point when frame changes (call/return) */
         if (!ttisnil(ra + 1)) {             /* continue loop? */
           setobjs2s(L, ra, ra + 1);         /* save control variable */
           ci->u.l.savedpc += GETARG_sBx(i); /* jump back */
+          updatetrap();
         }
         vmbreak;
       }
@@ -1241,3 +1311,10 @@ newframe: /* reentry point when frame changes (call/return) */
     }
   }
 }
+
+void luaV_execute(lua_State *L) {
+  if (G(L)->dispatch == LUA_DISPATCHJUMPTABLE)
+    execute<LUA_USE_JUMPTABLE>(L);
+  else
+    execute<false>(L);
+}
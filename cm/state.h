@@ -116,6 +116,33 @@ class State {
   inline void GCSetStepMultiplier(int step_multiplier);
   inline bool GCIsRunning();
 
+  // INCREMENTAL, the default, traverses the whole heap every cycle.
+  // GENERATIONAL mostly collects just the objects allocated since the last
+  // collection.  Entering GENERATIONAL runs a full collection.  Returns
+  // the previous mode.
+  enum class GCMode { INCREMENTAL, GENERATIONAL };
+
+  inline GCMode GCSetMode(GCMode mode);
+
+  // Counters since the state was created.  A pause is one run of the
+  // collector, between which the program runs.
+  struct GCStats {
+    int64 minor_collections;
+    int64 major_collections;
+    int64 pauses;
+    float64 pause_secs;
+    float64 max_pause_secs;
+    int64 freed_bytes;
+  };
+
+  inline GCStats GCGetStats();
+
+  // interpreter dispatch: JUMP_TABLE, the default where the compiler
+  // supports it, or SWITCH.  Returns false if the mode is not available.
+  enum class Dispatch { SWITCH, JUMP_TABLE };
+
+  inline bool SetDispatch(Dispatch dispatch);
+
   // global table
   inline void PushGlobalTable();
 
@@ -128,6 +155,10 @@ class State {
   inline void PushField(Index table, bool raw = false);
   [[gnu::warn_unused_result]] inline bool Next(Index table);
 
+  // tables, raw access to integer keys
+  inline void PopRawField(Index table, Integer key);
+  inline Type PushRawField(Index table, Integer key);
+
   // metatable
   inline void PopMetatable(Index index);
   [[gnu::warn_unused_result]] inline bool PushMetatable(Index index);
@@ -263,6 +294,26 @@ inline void State::GCSetStepMultiplier(int step_multiplier) {
 
 inline bool State::GCIsRunning() { return lua_gc(L, LUA_GCISRUNNING, 0); }
 
+inline State::GCMode State::GCSetMode(GCMode mode) {
+  return lua_gc(L, mode == GCMode::GENERATIONAL ? LUA_GCGEN : LUA_GCINC, 0) ==
+                 LUA_GCGEN
+             ? GCMode::GENERATIONAL
+             : GCMode::INCREMENTAL;
+}
+
+inline State::GCStats State::GCGetStats() {
+  lua_GCStats stats;
+  lua_gcstats(L, &stats);
+  return {stats.minorcollections, stats.majorcollections, stats.pauses,
+          stats.pausetime,        stats.maxpause,         stats.freedbytes};
+}
+
+inline bool State::SetDispatch(Dispatch dispatch) {
+  return lua_setdispatch(L, dispatch == Dispatch::JUMP_TABLE
+                                ? LUA_DISPATCHJUMPTABLE
+                                : LUA_DISPATCHSWITCH);
+}
+
 inline void State::PushNil() { lua_pushnil(L); }
 inline void State::PushBoolean(bool b) { lua_pushboolean(L, b); }
 inline void State::PushInteger(Integer i) { lua_pushinteger(L, i); }
@@ -322,6 +373,15 @@ inline void State::PopField(Index index, bool raw) {
     lua_settable(L, index);
 }
 
+inline void State::PopRawField(Index index, Integer key) {
+  lua_rawseti(L, index, key);
+}
+
+inline Type State::PushRawField(Index index, Integer key) {
+  lua_rawgeti(L, index, key);
+  return GetType(-1);
+}
+
 inline void State::Remove(Index index) { lua_remove(L, index); }
 
 inline void State::Replace(Index index) { lua_replace(L, index); }
@@ -452,6 +452,22 @@ TEST_F(StateTest, Calls) {
   EXPECT_ANY_THROW(state.CallProtected(0, 0));
 }
 
+TEST_F(StateTest, Dispatch) {
+  for (State::Dispatch dispatch :
+       {State::Dispatch::SWITCH, State::Dispatch::JUMP_TABLE}) {
+    if (!state.SetDispatch(dispatch)) continue;
+    state.LoadFromString(
+        "local function f(n) { if (n < 2) return n; "
+        "return f(n - 1) + f(n - 2); } "
+        "local t = {}; for (i = 0, 10) t[i] = f(i); return t[9];",
+        "test");
+    state.Call(0, 1);
+    EXPECT_EQ(state.ToInteger(1), 34);
+    state.Pop();
+  }
+  EXPECT_TRUE(state.SetDispatch(State::Dispatch::SWITCH));
+}
+
 TEST_F(StateTest, LoadSave) {
   state.LoadFromString("x,y = ...; return x + y;", "test",
                        State::ChunkFormat::TEXT);
@@ -483,6 +499,46 @@ TEST_F(StateTest, GCSmoke) {
   EXPECT_FALSE(state.GCIsRunning());
 }
 
+TEST_F(StateTest, GCGenerational) {
+  EXPECT_TRUE(state.GCSetMode(State::GCMode::GENERATIONAL) ==
+              State::GCMode::INCREMENTAL);
+  // Old tables keep pointing at young ones while most tables die young.
+  state.LoadFromString(R"(
+    kept = {};
+    for (i = 0, 200000)
+      kept[i & 1023] = {x = i, s = "young"};
+    local n = 0;
+    for (j = 0, 1024)
+      if (kept[j].x & 1023 == j && kept[j].s == "young")
+        n = n + 1;
+    return n;
+  )");
+  state.Call(0, 1);
+  EXPECT_EQ(state.ToInteger(-1), 1024);
+  state.Pop();
+
+  State::GCStats stats = state.GCGetStats();
+  EXPECT_GT(stats.minor_collections, 0);
+  EXPECT_GE(stats.major_collections, 1);
+  EXPECT_GT(stats.pauses, stats.major_collections);
+  EXPECT_GE(stats.pause_secs, stats.max_pause_secs);
+  EXPECT_GT(stats.freed_bytes, 0);
+
+  const int64 count = state.GCCount();
+  state.PushNewUserdata(100'000);
+  state.Pop();
+  state.GCCollect();
+  EXPECT_LT(state.GCCount(), count + 100'000);
+  EXPECT_EQ(state.GCGetStats().major_collections, stats.major_collections + 1);
+
+  EXPECT_TRUE(state.GCSetMode(State::GCMode::INCREMENTAL) ==
+              State::GCMode::GENERATIONAL);
+  state.PushNewUserdata(100'000);
+  state.Pop();
+  state.GCCollect();
+  EXPECT_LT(state.GCCount(), count + 100'000);
+}
+
 TEST_F(StateTest, Tables) {
   state.LoadFromString("y = 2 * x;");
   EXPECT_EQ(state.StackSize(), 1);
@@ -31,6 +31,46 @@ bool IsRegistered(Type type) {
   }
 }
 
+// Registered values are kept in integer slots of the registry, above the
+// ones Lua reserves, so a Value refers to its slot by number and a move just
+// takes the number over.  Freed slots are recycled through a list:
+// registry[kFreeSlots] holds the first, each free slot holds the next, and
+// 0 ends the list.  registry[kEndSlot] is the first slot never used.
+constexpr State::Integer kFreeSlots = LUA_RIDX_LAST + 1;
+constexpr State::Integer kEndSlot = LUA_RIDX_LAST + 2;
+constexpr State::Integer kFirstSlot = LUA_RIDX_LAST + 3;
+
+// The integer in a slot, or if_nil if the slot has never been set.
+State::Integer ReadSlot(State* state, State::Integer slot,
+                        State::Integer if_nil) {
+  if (state->PushRawField(State::REGISTRY, slot) != Type::NIL)
+    if_nil = state->ToInteger(-1);
+  state->Pop();
+  return if_nil;
+}
+
+// Pops the top of the stack into a free slot and returns the slot.
+int32 TakeSlot(State* state) {
+  State::Integer slot = ReadSlot(state, kFreeSlots, 0);
+  if (slot != 0) {
+    state->PushRawField(State::REGISTRY, slot);
+    state->PopRawField(State::REGISTRY, kFreeSlots);
+  } else {
+    slot = ReadSlot(state, kEndSlot, kFirstSlot);
+    state->PushInteger(slot + 1);
+    state->PopRawField(State::REGISTRY, kEndSlot);
+  }
+  state->PopRawField(State::REGISTRY, slot);
+  return slot;
+}
+
+void FreeSlot(State* state, int32 slot) {
+  state->PushInteger(ReadSlot(state, kFreeSlots, 0));
+  state->PopRawField(State::REGISTRY, slot);
+  state->PushInteger(slot);
+  state->PopRawField(State::REGISTRY, kFreeSlots);
+}
+
 }  // namespace
 
 Value::Value() : type_(Type::NIL) {}
@@ -72,19 +112,13 @@ Value::Value(std::initializer_list<std::pair<Value, Value>> il)
   PopRegister(registered);
 }
 
-Value::Value(const Function& func) {
-  PushFunction(Context::Current(), [func]() {
-    State* registered = Context::Current();
-    const int nargs = StackSize();
-    Values args(nargs);
-    for (int i = 0; i < nargs; ++i) args[i] = Value(registered, i + 1);
-    Values results = func(args);
-    const int nresults = results.size();
-    for (const Value& result : results) result.PushSelf(registered);
-    return nresults;
-  });
-  type_ = GetType(-1);
-  PopRegister(Context::Current());
+void CheckNativeArguments(State* state, int nparams, bool rest) {
+  const int nargs = state->StackSize();
+  if (rest ? nargs >= nparams - 1 : nargs == nparams) return;
+  state->Throw(EncodeAsString("expected ", rest ? "at least " : "",
+                              rest ? nparams - 1 : nparams, " argument",
+                              (rest ? nparams - 1 : nparams) == 1 ? "" : "s",
+                              ", got ", nargs));
 }
 
 Value Compile(string_view code) {
@@ -142,12 +176,23 @@ void Value::Assign(const Value& source) {
   }
 }
 
-Value::Value(const Value& source) { Assign(source); }
-Value::Value(Value&& source) {
-  Assign(source);
-  source.clear();
+// Takes over the slot of a registered source, leaving the source null.
+void Value::Steal(Value& source) {
+  if (IsRegistered(source.type_)) {
+    MUST(source.registered_ != nullptr);
+    type_ = source.type_;
+    registered_ = source.registered_;
+    slot_ = source.slot_;
+    source.registered_ = nullptr;
+  } else {
+    Assign(source);
+  }
+  source.type_ = Type::NIL;
 }
 
+Value::Value(const Value& source) { Assign(source); }
+Value::Value(Value&& source) { Steal(source); }
+
 Value& Value::operator=(const Value& source) {
   if (&source != this) {
     clear();
@@ -160,8 +205,7 @@ Value& Value::operator=(Value&& source) {
   if (IsRegistered(source.type_)) MUST(source.registered_ != nullptr);
   if (&source != this) {
     clear();
-    Assign(source);
-    source.clear();
+    Steal(source);
   }
   return *this;
 }
@@ -460,7 +504,13 @@ Values Value::operator()(const Values& args) const {
   PushSelf(registered);
   for (const Value& arg : args) arg.PushSelf(registered);
 
-  CallMultret(args.size());
+  try {
+    CallMultret(args.size());
+  } catch (...) {
+    // Leave the stack as it was found, without the error value.
+    Pop(StackSize() - top);
+    throw;
+  }
 
   const int nresults = StackSize() - top;
   Values results(nresults);
@@ -492,20 +542,7 @@ void Value::PopRegister(State* registered) {
   MUST(IsRegistered(popping_type));
   MUST(popping_type == type_);
   registered_ = registered;
-  PushThisPointer();
-  //  LOG(" registered = ", registered_);
-  registered_->PushCopy(-2);
-  registered_->PopField(State::REGISTRY);
-  registered_->Pop();
-}
-
-void Value::PushThisPointer() const {
-  //  LOG(reinterpret_cast<uintptr_t>(this), " at 3 this");
-  //  LOG(reinterpret_cast<uintptr_t>(registered_), " at 3 reg");
-  void* const this_code = const_cast<void*>(static_cast<const void*>(this));
-  //  LOG("  pushing this = ", reinterpret_cast<uintptr_t>(this_code));
-  MUST(registered_ != nullptr);
-  registered_->PushLightUserdata(this_code);
+  slot_ = TakeSlot(registered_);
 }
 
 void Value::PushSelf(State* expected_registered) const {
@@ -542,12 +579,8 @@ void Value::PushSelf(State* expected_registered) const {
       if (expected_registered != nullptr)
         MUST(expected_registered == registered_,
              "values from two different states used together");
-      //      LOG(reinterpret_cast<uintptr_t>(this), " at 2 this");
-      //      LOG(reinterpret_cast<uintptr_t>(registered_), " at 2 reg");
-
       //      LOG("PushSelf of ", TypeToString(type_));
-      PushThisPointer();
-      registered_->PushField(State::REGISTRY);
+      registered_->PushRawField(State::REGISTRY, slot_);
       volatile Type seen_type = GetType(-1);
       //      LOG("  pushed_type = ", TypeToString(seen_type));
       MUST(seen_type == type_);
@@ -561,9 +594,7 @@ void Value::PushSelf(State* expected_registered) const {
 void Value::Deregister() {
   if (IsRegistered(type_)) MUST(registered_ != nullptr);
   //  LOG("Deregister of ", TypeToString(type_));
-  PushThisPointer();
-  registered_->PushNil();
-  registered_->PopField(State::REGISTRY);
+  FreeSlot(registered_, slot_);
   registered_ = nullptr;
 }
 
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "cm/api.h"
@@ -12,14 +16,24 @@ namespace cm {
 class Value;
 
 using Values = std::vector<Value>;
-using Function = std::function<Values(const Values& args)>;
 
 template <typename T, typename... Args>
 Value MakeObject(Args&&... args);
 
+// Makes a function that cm code can call out of f, a function or lambda.
+// Its parameter and return types are converted straight from and to the
+// stack: bool, integers, floats, string, string_view, Value, and void for
+// no result.  A trailing Values parameter takes the remaining arguments, and
+// a Values result returns any number of them.  Other arguments must match
+// the parameters in number and type, or the call throws.
 template <typename F>
 Value MakeFunction(F&& f);
 
+// How MakeFunction reads a parameter of type T from the stack and pushes a
+// result of type T, returning the number of values pushed.
+template <typename T, typename Enable = void>
+struct NativeType;
+
 template <typename T>
 Value MakePointer(T*);
 
@@ -150,9 +164,6 @@ class Value {
   void emplace(Args&&... args);
 
  private:
-  // function
-  Value(const Function&);
-
   // light userdata
   enum make_pointer_tag {};
   Value(make_pointer_tag, void*);
@@ -160,8 +171,8 @@ class Value {
   Value(State* state, State::Index index);
 
   void Assign(const Value&);
+  void Steal(Value&);
   void PopRegister(State* registered);
-  void PushThisPointer() const;
   void PushSelf(State* expected_registered = nullptr) const;
   void Deregister();
 
@@ -173,6 +184,8 @@ class Value {
     State* registered_;
   };
   Type type_;
+  // The registry slot of a registered value.
+  int32 slot_;
 
   template <typename F>
   friend bool CompareValues(F f, const Value& a, const Value& b);
@@ -185,6 +198,8 @@ class Value {
   friend Value Global();
   template <typename T>
   friend Value ObjectMetatable();
+  template <typename T, typename Enable>
+  friend struct NativeType;
 };
 
 template <typename T, typename... Args>
@@ -194,9 +209,152 @@ Value MakeObject(Args&&... args) {
   return v;
 }
 
+template <>
+struct NativeType<bool> {
+  static bool Read(State* state, State::Index index) {
+    return state->ToBoolean(index);
+  }
+  static int Push(State* state, bool b) {
+    state->PushBoolean(b);
+    return 1;
+  }
+};
+
+template <typename T>
+struct NativeType<T, std::enable_if_t<std::is_integral<T>::value>> {
+  static T Read(State* state, State::Index index) {
+    return state->ToInteger(index);
+  }
+  static int Push(State* state, T i) {
+    state->PushInteger(i);
+    return 1;
+  }
+};
+
+template <typename T>
+struct NativeType<T, std::enable_if_t<std::is_floating_point<T>::value>> {
+  static T Read(State* state, State::Index index) {
+    if (state->GetType(index) == Type::INTEGER) return state->ToInteger(index);
+    return state->ToFloat(index);
+  }
+  static int Push(State* state, T f) {
+    state->PushFloat(f);
+    return 1;
+  }
+};
+
+// Only valid until the function returns.
+template <>
+struct NativeType<string_view> {
+  static string_view Read(State* state, State::Index index) {
+    return state->ToString(index);
+  }
+  static int Push(State* state, string_view s) {
+    state->PushString(s);
+    return 1;
+  }
+};
+
+template <>
+struct NativeType<string> {
+  static string Read(State* state, State::Index index) {
+    return state->ToString(index).to_string();
+  }
+  static int Push(State* state, const string& s) {
+    state->PushString(s);
+    return 1;
+  }
+};
+
+template <>
+struct NativeType<Value> {
+  static Value Read(State* state, State::Index index) {
+    return {state, index};
+  }
+  static int Push(State* state, const Value& v) {
+    v.PushSelf(state);
+    return 1;
+  }
+};
+
+template <>
+struct NativeType<Values> {
+  // The arguments from index on.
+  static Values Read(State* state, State::Index index) {
+    Values values;
+    values.reserve(std::max(state->StackSize() - index + 1, 0));
+    for (; index <= state->StackSize(); index++)
+      values.push_back(NativeType<Value>::Read(state, index));
+    return values;
+  }
+  static int Push(State* state, const Values& values) {
+    state->CheckStack(values.size());
+    for (const Value& v : values) v.PushSelf(state);
+    return values.size();
+  }
+};
+
+// Throws unless the stack holds the arguments of a function with nparams
+// parameters, the last of them Values if rest.
+void CheckNativeArguments(State* state, int nparams, bool rest);
+
+template <typename R, typename... Args>
+struct NativeCall {
+  template <typename F, size_t... I>
+  static int Call(F& f, State* state, std::index_sequence<I...>) {
+    return NativeType<std::decay_t<R>>::Push(
+        state, f(NativeType<std::decay_t<Args>>::Read(state, I + 1)...));
+  }
+};
+
+template <typename... Args>
+struct NativeCall<void, Args...> {
+  template <typename F, size_t... I>
+  static int Call(F& f, State* state, std::index_sequence<I...>) {
+    f(NativeType<std::decay_t<Args>>::Read(state, I + 1)...);
+    return 0;
+  }
+};
+
+// The parameter and return types of a function, function pointer or
+// object with a single operator().
+template <typename F>
+struct NativeSignature : NativeSignature<decltype(&F::operator())> {};
+
+template <typename R, typename... Args>
+struct NativeSignature<R (*)(Args...)> {
+  template <typename F>
+  static int Call(F& f, State* state) {
+    using Last = std::tuple_element_t<sizeof...(Args), std::tuple<R, Args...>>;
+    constexpr bool rest =
+        sizeof...(Args) > 0 && std::is_same<std::decay_t<Last>, Values>::value;
+    CheckNativeArguments(state, sizeof...(Args), rest);
+    return NativeCall<R, Args...>::Call(f, state,
+                                        std::index_sequence_for<Args...>());
+  }
+};
+
+template <typename R, typename... Args>
+struct NativeSignature<R(Args...)> : NativeSignature<R (*)(Args...)> {};
+
+template <typename C, typename R, typename... Args>
+struct NativeSignature<R (C::*)(Args...)> : NativeSignature<R (*)(Args...)> {
+};
+
+template <typename C, typename R, typename... Args>
+struct NativeSignature<R (C::*)(Args...) const>
+    : NativeSignature<R (*)(Args...)> {};
+
 template <typename F>
 Value MakeFunction(F&& f) {
-  return {Function(std::forward<F>(f))};
+  using Signature = NativeSignature<std::decay_t<F>>;
+  State* registered = Context::Current();
+  PushFunction(registered, [f = std::forward<F>(f)]() mutable {
+    return Signature::Call(f, Context::Current());
+  });
+  Value result(registered, -1);
+  registered->Pop();
+  return result;
 }
 
 template <typename T>
@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <iostream>
+
+#include "main/noargs.h"
+#include "cm/context.h"
+#include "cm/state.h"
+#include "cm/value.h"
+
+using namespace cm;
+
+constexpr int64 kValues = 1000;
+constexpr int64 kRounds = 1000;
+
+// Runs f, which does ops operations, kRounds times.
+template <typename F>
+void Report(const string& name, int64 ops, F f) {
+  const float64 start = now_secs();
+  for (int64 round = 0; round < kRounds; round++) f();
+  const float64 elapsed = now_secs() - start;
+  std::cout << name << ": " << elapsed * 1e9 / (ops * kRounds) << " ns/op"
+            << std::endl;
+}
+
+Values MakeStrings() {
+  Values values;
+  for (int64 i = 0; i < kValues; i++) values.push_back("value");
+  return values;
+}
+
+void Main() {
+  State state;
+  Context context(state);
+
+  // Growing the vector moves every string already in it.
+  Report("push_back strings", kValues, [] { MakeStrings(); });
+
+  // Only moves: each step of the rotation is a swap.
+  Values strings = MakeStrings();
+  Report("rotate strings", kValues, [&] {
+    std::rotate(strings.begin(), strings.begin() + 1, strings.end());
+  });
+
+  Values tables;
+  for (int64 i = 0; i < kValues; i++) tables.push_back({{"key", i}});
+  Report("reverse tables", kValues,
+         [&] { std::reverse(tables.begin(), tables.end()); });
+
+  // The results of a call are returned in a Values.
+  Value f = Compile("return ...;");
+  Values args = {"a", "b", "c", 1, 2, 3};
+  Report("call returning 6 values", kValues, [&] {
+    for (int64 i = 0; i < kValues; i++) f(args);
+  });
+
+  Value make = MakeFunction([](const Values& args) { return args; });
+  Report("native call returning 6 values", kValues, [&] {
+    for (int64 i = 0; i < kValues; i++) make(args);
+  });
+
+  // Natives called from a cm loop, typed and taking Values.
+  Global().insert("noop", MakeFunction([] {}));
+  Global().insert("add",
+                  MakeFunction([](int64 a, int64 b) { return a + b; }));
+  Global().insert("add_values",
+                  MakeFunction([](const Values& args) -> Values {
+                    return {int64(args.at(0)) + int64(args.at(1))};
+                  }));
+  Global().insert("length",
+                  MakeFunction([](string_view s) { return s.size(); }));
+  Global().insert("length_values",
+                  MakeFunction([](const Values& args) -> Values {
+                    return {string(args.at(0)).size()};
+                  }));
+  for (const char* call :
+       {"noop()", "add(i, 1)", "add_values(i, 1)", "length(\"value\")",
+        "length_values(\"value\")"}) {
+    const string code =
+        string("return function(n) { for (i = 0, n) ") + call + "; };";
+    Value loop = Compile(code)({})[0];
+    Report(string("cm calling ") + call, kValues, [&] { loop({kValues}); });
+  }
+}
@@ -13,6 +13,10 @@ struct ValueTest : testing::Test {
     PushNil();
     while (Next(State::REGISTRY)) {
       EXPECT_FALSE(GetType(-2) == Type::LIGHT_USERDATA);
+      // Value slots, once released, only link the free list.
+      if (GetType(-2) == Type::INTEGER && ToInteger(-2) > LUA_RIDX_LAST) {
+        EXPECT_TRUE(GetType(-1) == Type::INTEGER);
+      }
       Pop();
     }
     EXPECT_EQ(StackSize(), 0);
@@ -103,6 +107,28 @@ TEST_F(ValueTest, StringConstruction) {
   //  StringConstructionTest(string(5'000'000'000, 'x'));
 }
 
+TEST_F(ValueTest, Moves) {
+  Values values;
+  for (int i = 0; i < 100; i++) values.push_back(string(i, 'x'));
+  for (int i = 0; i < 100; i++) EXPECT_EQ(string(values[i]), string(i, 'x'));
+
+  Value moved = std::move(values[5]);
+  EXPECT_TRUE(values[5].empty());
+  EXPECT_EQ(string(moved), "xxxxx");
+  values[5] = std::move(values[6]);
+  EXPECT_TRUE(values[6].empty());
+  EXPECT_EQ(string(values[5]), "xxxxxx");
+  values[5] = std::move(values[5]);
+  EXPECT_EQ(string(values[5]), "xxxxxx");
+
+  Value copy = moved;
+  moved.clear();
+  EXPECT_EQ(string(copy), "xxxxx");
+  values.clear();
+  for (int i = 0; i < 100; i++) values.push_back(string(i, 'y'));
+  for (int i = 0; i < 100; i++) EXPECT_EQ(string(values[i]), string(i, 'y'));
+}
+
 void TableConstructionTest(std::initializer_list<std::pair<Value, Value>> il) {
   Value table(il);
   EXPECT_FALSE(table.empty());
@@ -145,6 +171,39 @@ TEST_F(ValueTest, FunctionConstruction) {
   EXPECT_TRUE((v == std::vector<Value>{3, 2, 1}));
 }
 
+TEST_F(ValueTest, TypedFunctionConstruction) {
+  Value add = MakeFunction([](int64 a, float64 b) { return a + b; });
+  EXPECT_EQ(add({1, 2.5}).at(0), 3.5);
+  EXPECT_EQ(add({1, 2}).at(0), 3.0);
+  EXPECT_ANY_THROW(add({1}));
+  EXPECT_ANY_THROW(add({1, "x"}));
+
+  Value repeat = MakeFunction([](const string& s, int n, bool twice) {
+    string result;
+    for (int i = 0; i < (twice ? 2 * n : n); i++) result += s;
+    return result;
+  });
+  EXPECT_EQ(repeat({"ab", 2, false}).at(0), "abab");
+  EXPECT_EQ(repeat({"ab", 2, true}).at(0), "abababab");
+
+  int64 calls = 0;
+  Value count = MakeFunction([&calls](string_view s, const Values& rest) {
+    calls += s.size() + rest.size();
+  });
+  EXPECT_TRUE(count({"abc", 1, 2}).empty());
+  EXPECT_TRUE(count({"abc"}).empty());
+  EXPECT_EQ(calls, 8);
+  EXPECT_ANY_THROW(count({}));
+
+  Value pair = MakeFunction([](const Value& table) -> Values {
+    return {table["a"], table["b"]};
+  });
+  EXPECT_TRUE((pair({Value{{"a", 1}, {"b", "x"}}}) == Values{1, "x"}));
+
+  Global().insert("twice", MakeFunction([](int64 i) { return 2 * i; }));
+  EXPECT_EQ(Compile("return twice(21);")({}).at(0), 42);
+}
+
 TEST_F(ValueTest, Compile) {
   Value f = Compile(R"(
     x = 42;
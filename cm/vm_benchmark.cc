@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+#include "core/must.h"
+#include "main/noargs.h"
+#include "cm/context.h"
+#include "cm/library.h"
+#include "cm/state.h"
+#include "cm/value.h"
+
+using namespace cm;
+
+// Each workload is a chunk returning a function that is called with n and
+// performs ops operations.
+struct Workload {
+  const char* name;
+  const char* code;
+  int64 n;
+  int64 ops;
+};
+
+constexpr int kFibN = 27;
+
+// Each timing is the best of this many runs.
+constexpr int kRuns = 3;
+
+// The number of calls fib(n) makes, counting itself.
+constexpr int64 FibCalls(int n) {
+  int64 a = 1, b = 1;
+  for (int i = 1; i < n; i++) {
+    const int64 c = a + b + 1;
+    a = b;
+    b = c;
+  }
+  return b;
+}
+
+const Workload kWorkloads[] = {
+    {"fib", R"(
+      local function fib(n) {
+        if (n < 2)
+          return n;
+        return fib(n - 1) + fib(n - 2);
+      }
+      return function(n) { fib(n); };
+    )",
+     kFibN, FibCalls(kFibN)},
+    {"table churn", R"(
+      return function(n) {
+        for (i = 0, n) {
+          local t = {x = i, y = i + 1};
+          t.z = t.x + t.y;
+          t[0] = t.z;
+        }
+      };
+    )",
+     2'000'000, 2'000'000},
+    {"string concat", R"(
+      return function(n) {
+        local s;
+        for (i = 0, n)
+          s = cat("key", i);
+      };
+    )",
+     2'000'000, 2'000'000},
+    {"method calls", R"(
+      local counter = {count = 0};
+      function counter:add(d) {
+        self.count = self.count + d;
+      }
+      return function(n) {
+        for (i = 0, n)
+          counter:add(1);
+      };
+    )",
+     10'000'000, 10'000'000},
+};
+
+// Returns nullopt if the dispatch mode is not available in this build.
+optional<float64> NanosPerOp(const Workload& workload, Dispatch dispatch) {
+  State state;
+  Context context(state);
+  InstallStandardLibrary();
+  if (!SetDispatch(dispatch)) return nullopt;
+  Value f = Compile(workload.code)({})[0];
+  float64 best = std::numeric_limits<float64>::infinity();
+  for (int run = 0; run < kRuns; run++) {
+    const float64 start = now_secs();
+    f({workload.n});
+    best = std::min(best, now_secs() - start);
+  }
+  return best * 1e9 / workload.ops;
+}
+
+void Main() {
+  for (const Workload& workload : kWorkloads) {
+    const optional<float64> with_switch =
+        NanosPerOp(workload, Dispatch::SWITCH);
+    MUST(with_switch);
+    std::cout << workload.name << " switch: " << *with_switch << " ns/op"
+              << std::endl;
+    const optional<float64> with_jump_table =
+        NanosPerOp(workload, Dispatch::JUMP_TABLE);
+    if (!with_jump_table) {
+      std::cout << workload.name << " jump table: not available" << std::endl;
+      continue;
+    }
+    std::cout << workload.name << " jump table: " << *with_jump_table
+              << " ns/op (" << *with_switch / *with_jump_table << "x)"
+              << std::endl;
+  }
+}
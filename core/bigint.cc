@@ -1,5 +1,7 @@
 #include "core/bigint.h"
 
+#include "core/must.h"
+
 std::string pack_bigint(bigint n) {
   std::vector<uint8> ne;
   do {
@@ -13,3 +15,39 @@ std::string pack_bigint(bigint n) {
   const std::string s((const char*)ne.data(), ne.size());
   return s;
 }
+
+size_t pack_uint64(uint64 n, char* out) {
+  const size_t bits = n == 0 ? 1 : 64 - __builtin_clzll(n);
+  const size_t groups = (bits + 6) / 7;
+  for (size_t i = 0; i < groups; i++) {
+    const size_t shift = 7 * (groups - 1 - i);
+    out[i] = char(((n >> shift) & 0b0111'1111) | 0b1000'0000);
+  }
+  out[groups - 1] &= 0b0111'1111;
+  return groups;
+}
+
+std::string pack_uint64(uint64 n) {
+  char buf[kMaxPackedUint64Size];
+  return std::string(buf, pack_uint64(n, buf));
+}
+
+void pack_uint64s(const uint64* values, size_t count, std::string& out) {
+  size_t pos = out.size();
+  out.resize(pos + count * kMaxPackedUint64Size);
+  for (size_t i = 0; i < count; i++) pos += pack_uint64(values[i], &out[pos]);
+  out.resize(pos);
+}
+
+void ThrowUnpackUint64Overflow() { FAIL("packed integer overflows uint64"); }
+
+size_t unpack_uint64s(string_view in, uint64* values, size_t count) {
+  const char* const begin = in.data();
+  const char* const end = begin + in.size();
+  const char* p = begin;
+  for (size_t i = 0; i < count; i++) {
+    p = unpack_uint64(p, end, values[i]);
+    MUST(p, "unexpected end of packed integers");
+  }
+  return p - begin;
+}
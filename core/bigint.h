@@ -124,3 +124,54 @@ optional<bigint> unpack_bigint(GetCharFunction get_next_char) {
   }
   return result;
 }
+
+// Fixed-width versions of pack_bigint/unpack_bigint for values that fit in a
+// uint64.  They produce and accept exactly the same bytes, so either can read
+// what the other wrote, but never touch cpp_int.
+
+constexpr size_t kMaxPackedUint64Size = 10;
+
+// Writes the encoding of n to out, which must have room for
+// kMaxPackedUint64Size bytes, and returns the number of bytes written.
+size_t pack_uint64(uint64 n, char* out);
+std::string pack_uint64(uint64 n);
+
+// Appends the encodings of values[0, count) to out.
+void pack_uint64s(const uint64* values, size_t count, std::string& out);
+
+[[noreturn]] void ThrowUnpackUint64Overflow();
+
+// Decodes one integer from [begin, end) into n.  Returns the position after
+// it, or nullptr if the input ends first.
+inline const char* unpack_uint64(const char* begin, const char* end,
+                                 uint64& n) {
+  uint64 result = 0;
+  for (const char* p = begin; p < end; p++) {
+    if (result >> 57) ThrowUnpackUint64Overflow();
+    const uint8 m = uint8(*p);
+    result = (result << 7) | (m & 0b0111'1111);
+    if (!(m & 0b1000'0000)) {
+      n = result;
+      return p + 1;
+    }
+  }
+  return nullptr;
+}
+
+template <typename GetCharFunction>
+optional<uint64> unpack_uint64(GetCharFunction get_next_char) {
+  optional<uint8> first_char = get_next_char();
+  if (!first_char) return nullopt;
+  uint8 m(*first_char);
+  uint64 result = (m & 0b0111'1111);
+  while (m & 0b1000'0000) {
+    if (result >> 57) ThrowUnpackUint64Overflow();
+    m = get_next_char().value();
+    result = (result << 7) | (m & 0b0111'1111);
+  }
+  return result;
+}
+
+// Decodes count integers from the front of in into values.  Returns the
+// number of bytes consumed.
+size_t unpack_uint64s(string_view in, uint64* values, size_t count);
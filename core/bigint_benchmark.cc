@@ -0,0 +1,66 @@
+#include <iostream>
+
+#include "core/bigint.h"
+#include "main/noargs.h"
+
+constexpr uint64 kIntegers = 10'000'000;
+
+template <typename F>
+void Report(const string& name, F f) {
+  const float64 start = now_secs();
+  f();
+  const float64 elapsed = now_secs() - start;
+  std::cout << name << ": " << int64(kIntegers / elapsed) << " integers/sec"
+            << std::endl;
+}
+
+// Integers of the sizes record lengths and socket counters actually take.
+static uint64 Value(uint64 i) { return (i * 2654435761u) >> (i % 40); }
+
+void Main() {
+  string bigint_packed, uint64_packed, bulk_packed;
+  uint64 checksum = 0;
+
+  Report("pack_bigint", [&] {
+    for (uint64 i = 0; i < kIntegers; i++)
+      bigint_packed += pack_bigint(Value(i));
+  });
+  Report("pack_uint64", [&] {
+    char buf[kMaxPackedUint64Size];
+    for (uint64 i = 0; i < kIntegers; i++)
+      uint64_packed.append(buf, pack_uint64(Value(i), buf));
+  });
+  std::vector<uint64> values(kIntegers);
+  for (uint64 i = 0; i < kIntegers; i++) values[i] = Value(i);
+  Report("pack_uint64s", [&] {
+    pack_uint64s(values.data(), values.size(), bulk_packed);
+  });
+
+  Report("unpack_bigint", [&] {
+    size_t pos = 0;
+    for (uint64 i = 0; i < kIntegers; i++) {
+      bigint n = unpack_bigint([&]() -> optional<uint8> {
+        return uint8(bigint_packed[pos++]);
+      }).value();
+      checksum += uint64(n);
+    }
+  });
+  Report("unpack_uint64", [&] {
+    const char* p = uint64_packed.data();
+    const char* end = p + uint64_packed.size();
+    for (uint64 i = 0; i < kIntegers; i++) {
+      uint64 n = 0;
+      p = unpack_uint64(p, end, n);
+      checksum -= n;
+    }
+  });
+  Report("unpack_uint64s", [&] {
+    unpack_uint64s(bulk_packed, values.data(), values.size());
+  });
+
+  if (bigint_packed != uint64_packed || uint64_packed != bulk_packed ||
+      checksum != 0) {
+    std::cerr << "encodings differ" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+}
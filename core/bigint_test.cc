@@ -46,3 +46,48 @@ TEST(BigIntTest, Unpack) {
     EXPECT_EQ(i, UnpackString(pack_bigint(i)));
   }
 }
+
+TEST(BigIntTest, PackUint64MatchesBigint) {
+  std::vector<uint64> values = {0, 1, 0x7F, 0x80, 0x3FFF, 0x4000,
+                                std::numeric_limits<uint64>::max()};
+  for (int shift = 0; shift < 64; shift++) {
+    values.push_back(uint64(1) << shift);
+    values.push_back((uint64(1) << shift) - 1);
+    values.push_back(0x9E3779B97F4A7C15ull >> shift);
+  }
+  for (uint64 value : values) {
+    const string packed = pack_uint64(value);
+    EXPECT_EQ(pack_bigint(value), packed);
+    EXPECT_EQ(bigint(value), UnpackString(packed));
+
+    StringGetter sg(packed);
+    EXPECT_EQ(value, unpack_uint64(sg).value());
+
+    uint64 n = 0;
+    EXPECT_EQ(packed.data() + packed.size(),
+              unpack_uint64(packed.data(), packed.data() + packed.size(), n));
+    EXPECT_EQ(value, n);
+    EXPECT_EQ(nullptr, unpack_uint64(packed.data(),
+                                     packed.data() + packed.size() - 1, n));
+  }
+}
+
+TEST(BigIntTest, PackUint64Bulk) {
+  std::vector<uint64> values;
+  for (uint64 i = 0; i < 1000; i++) values.push_back(i * i * i * i * i);
+  string packed = "prefix";
+  pack_uint64s(values.data(), values.size(), packed);
+
+  std::vector<uint64> unpacked(values.size());
+  const string_view in = string_view(packed).substr(6);
+  EXPECT_EQ(in.size(), unpack_uint64s(in, unpacked.data(), unpacked.size()));
+  EXPECT_EQ(values, unpacked);
+}
+
+TEST(BigIntTest, UnpackUint64Overflow) {
+  const string too_big =
+      pack_bigint(bigint(std::numeric_limits<uint64>::max()) + 1);
+  uint64 n;
+  EXPECT_ANY_THROW(
+      unpack_uint64(too_big.data(), too_big.data() + too_big.size(), n));
+}
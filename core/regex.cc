@@ -1,10 +1,11 @@
 #include "core/regex.h"
 
-#include "core/must.h"
+#include <vector>
 
-namespace {
+#include "core/must.h"
+#include "core/regex_private.h"
 
-string GetErrorMessage(int errorcode) {
+string Pcre2ErrorMessage(int errorcode) {
   constexpr size_t bufflen = 256;
   unsigned char buffer[bufflen];
 
@@ -15,6 +16,8 @@ string GetErrorMessage(int errorcode) {
     return std::to_string(errorcode);
 }
 
+namespace {
+
 pcre2_code* checked_pcre2_compile(string_view pattern, uint32 options) {
   int errorcode;
   size_t erroroffset;
@@ -22,7 +25,8 @@ pcre2_code* checked_pcre2_compile(string_view pattern, uint32 options) {
       pcre2_compile((const unsigned char*)pattern.data(), pattern.size(),
                     options, &errorcode, &erroroffset, nullptr);
   if (!code) {
-    const string error_message = "pcre2_compile: " + GetErrorMessage(errorcode);
+    const string error_message =
+        "pcre2_compile: " + Pcre2ErrorMessage(errorcode);
     size_t start_code_sample = (erroroffset > 20 ? erroroffset - 20 : 0);
     const string code_sample =
         pattern.substr(start_code_sample, 40).to_string();
@@ -33,10 +37,73 @@ pcre2_code* checked_pcre2_compile(string_view pattern, uint32 options) {
   return code;
 }
 
+// The match data and JIT stack of one thread, reused by every match the
+// thread runs.  Match data is handed out to Results and given back when they
+// are destroyed, so nested matches each get their own.
+struct ThreadMatchState {
+  pcre2_match_context* context = nullptr;
+  pcre2_jit_stack* jit_stack = nullptr;
+  std::vector<pcre2_match_data*> free_match_data;
+
+  ~ThreadMatchState() {
+    for (pcre2_match_data* md : free_match_data) pcre2_match_data_free(md);
+    pcre2_match_context_free(context);
+    pcre2_jit_stack_free(jit_stack);
+  }
+
+  pcre2_match_context* JitContext() {
+    if (!context) {
+      constexpr size_t kStartSize = 32 * 1024;
+      constexpr size_t kMaxSize = 1024 * 1024;
+      context = pcre2_match_context_create(nullptr);
+      jit_stack = pcre2_jit_stack_create(kStartSize, kMaxSize, nullptr);
+      if (!context || !jit_stack) FAIL("pcre2_jit_stack_create failed");
+      pcre2_jit_stack_assign(context, nullptr, jit_stack);
+    }
+    return context;
+  }
+
+  pcre2_match_data* AcquireMatchData(uint32 ovector_pairs) {
+    pcre2_match_data* md = nullptr;
+    if (!free_match_data.empty()) {
+      md = free_match_data.back();
+      free_match_data.pop_back();
+      if (pcre2_get_ovector_count(md) < ovector_pairs) {
+        pcre2_match_data_free(md);
+        md = nullptr;
+      }
+    }
+    if (!md) md = pcre2_match_data_create(ovector_pairs, nullptr);
+    if (!md) FAIL("pcre2_match_data_create failed");
+    return md;
+  }
+};
+
+thread_local ThreadMatchState thread_match_state;
+
+void ReleaseMatchData(pcre2_match_data* md) {
+  thread_match_state.free_match_data.push_back(md);
+}
+
+uint32 CaptureCount(const pcre2_code* code) {
+  uint32 capture_count;
+  int result =
+      pcre2_pattern_info(code, PCRE2_INFO_CAPTURECOUNT, &capture_count);
+  if (result != 0) FAIL("pcre2_pattern_info: ", Pcre2ErrorMessage(result));
+  return capture_count;
+}
+
 }  // namespace
 
-Regex::Regex(string_view pattern, uint32 options)
-    : code_(checked_pcre2_compile(pattern, options), pcre2_code_free) {}
+Regex::Regex(string_view pattern, uint32 options, Engine engine)
+    : code_(checked_pcre2_compile(pattern, options), pcre2_code_free),
+      ovector_pairs_(CaptureCount(code_.get()) + 1) {
+  if (engine == JIT) {
+    int result = pcre2_jit_compile(code_.get(), PCRE2_JIT_COMPLETE);
+    if (result != 0) FAIL("pcre2_jit_compile: ", Pcre2ErrorMessage(result));
+    jit_ = true;
+  }
+}
 
 bool Regex::Matches(string_view subject) {
   Results results = Match(subject, 0 /* startoffset */, 0 /* options */);
@@ -45,20 +112,26 @@ bool Regex::Matches(string_view subject) {
 
 Regex::Results Regex::Match(string_view subject, size_t startoffset,
                             uint32 options) {
-  Results result(pcre2_match_data_create_from_pattern(code_.get(), nullptr));
+  Results result(thread_match_state.AcquireMatchData(ovector_pairs_));
   result.subject_ = subject;
-  result.pcre2_match_result_ = pcre2_match(
-      code_.get(), (const unsigned char*)subject.data(), subject.size(),
-      startoffset, options, result.md_.get(), nullptr);
+  if (jit_) {
+    result.pcre2_match_result_ = pcre2_jit_match(
+        code_.get(), (const unsigned char*)subject.data(), subject.size(),
+        startoffset, options, result.md_.get(),
+        thread_match_state.JitContext());
+  } else {
+    result.pcre2_match_result_ = pcre2_match(
+        code_.get(), (const unsigned char*)subject.data(), subject.size(),
+        startoffset, options, result.md_.get(), nullptr);
+  }
 
   if (result.pcre2_match_result_ < 0 &&
       result.pcre2_match_result_ != PCRE2_ERROR_NOMATCH)
-    FAIL("pcre2_match: ", GetErrorMessage(result.pcre2_match_result_));
+    FAIL("pcre2_match: ", Pcre2ErrorMessage(result.pcre2_match_result_));
   return result;
 }
 
-Regex::Results::Results(pcre2_match_data* md)
-    : md_(md, pcre2_match_data_free) {}
+Regex::Results::Results(pcre2_match_data* md) : md_(md, ReleaseMatchData) {}
 
 size_t Regex::Results::size() const {
   if (pcre2_match_result_ < 0)
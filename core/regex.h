@@ -6,6 +6,11 @@
 
 class Regex {
  public:
+  // JIT compiles the pattern to machine code, which matches several times
+  // faster but costs more to construct.  Worth it for a pattern that will be
+  // matched against many subjects.
+  enum Engine { INTERPRETER, JIT };
+
   // Construction Options
   // PCRE2_ANCHORED           Force pattern anchoring
   // PCRE2_ALT_BSUX           Alternative handling of \u, \U, and \x
@@ -32,7 +37,7 @@ class Regex {
   // PCRE2_UCP                Use Unicode properties for \d, \w, etc.
   // PCRE2_UNGREEDY           Invert greediness of quantifiers
   // PCRE2_UTF                Treat pattern and subjects as UTF strings
-  Regex(string_view pattern, uint32 options = 0);
+  Regex(string_view pattern, uint32 options = 0, Engine engine = INTERPRETER);
 
   bool Matches(string_view subject);
 
@@ -43,6 +48,9 @@ class Regex {
   template <typename F>
   size_t Scan(string_view subject, F capture_function);
 
+  // The number of capturing groups in the pattern.
+  size_t capture_count() const { return ovector_pairs_ - 1; }
+
   class Results;
 
  private:
@@ -62,8 +70,14 @@ class Regex {
   Results Match(string_view subject, size_t startoffset, uint32 options);
 
   std::unique_ptr<pcre2_code, void (*)(pcre2_code*)> code_;
+  uint32 ovector_pairs_;
+  bool jit_ = false;
+
+  friend class RegexSet;
 };
 
+// Results hold match data borrowed from a per-thread pool, and return it
+// when destroyed, so that matching does not allocate once the pool is warm.
 class Regex::Results {
  public:
   size_t size() const;
@@ -78,6 +92,7 @@ class Regex::Results {
   int pcre2_match_result_;
 
   friend class Regex;
+  friend class RegexSet;
 };
 
 template <typename F>
@@ -0,0 +1,125 @@
+#include <iostream>
+#include <vector>
+
+#include "core/regex.h"
+#include "core/regex_set.h"
+#include "main/noargs.h"
+
+constexpr size_t kRows = 2'000'000;
+
+// The pattern audio/transform_speechtext.cc filters subtitle rows with.
+constexpr char kGoodWritten[] =
+    R"(^(\<i\>)?[-A-Za-z0-9 \.\,\?\'\!\"\n]+(\<\/i\>)?$)";
+
+// Patterns a row might be classified by, kGoodWritten among them.
+const std::vector<string> kClassifiers = {
+    kGoodWritten, "^<i>", R"(\d)", "♪", R"(\[[^]]*\])", R"(\?$)", "said",
+    "^- ",
+};
+
+// Rows shaped like the speech-text corpus: mostly short plain lines, some in
+// italics, some spanning two lines, and some the filter rejects.
+static std::vector<string> MakeRows() {
+  const std::vector<string> shapes = {
+      "Where are you going?",
+      "<i>I told you, it's not like that.</i>",
+      "- Come on!\n- No, wait.",
+      "[door slams]",
+      "We have 24 hours to get out of here, so move it.",
+      "♪ Music playing ♪",
+      "Okay.",
+      "He said \"never\", and he meant it.",
+  };
+  std::vector<string> rows;
+  rows.reserve(kRows);
+  for (size_t i = 0; i < kRows; i++)
+    rows.push_back(shapes[(i * 7) % shapes.size()] + std::to_string(i % 10));
+  return rows;
+}
+
+template <typename F>
+size_t Report(const string& name, F f) {
+  const float64 start = now_secs();
+  const size_t result = f();
+  const float64 elapsed = now_secs() - start;
+  std::cout << name << ": " << int64(kRows / elapsed) << " rows/sec"
+            << std::endl;
+  return result;
+}
+
+void Main() {
+  const std::vector<string> rows = MakeRows();
+  Regex interpreted(kGoodWritten);
+  Regex jit(kGoodWritten, 0, Regex::JIT);
+  Regex interpreted_words(R"(([A-Za-z]+))");
+  Regex jit_words(R"(([A-Za-z]+))", 0, Regex::JIT);
+
+  auto count_matches = [&](Regex& regex) {
+    return [&] {
+      size_t matches = 0;
+      for (const string& row : rows) matches += regex.Matches(row);
+      return matches;
+    };
+  };
+  auto count_words = [&](Regex& regex) {
+    return [&] {
+      size_t words = 0;
+      for (const string& row : rows)
+        words += regex.Scan(row, [](Regex::Results) {});
+      return words;
+    };
+  };
+
+  // Each returns the sum over rows of the indexes of the matching patterns.
+  auto classify_set = [&](RegexSet& set) {
+    return [&] {
+      size_t sum = 0;
+      std::vector<size_t> indexes;
+      for (const string& row : rows) {
+        set.Matches(row, indexes);
+        for (size_t index : indexes) sum += index;
+      }
+      return sum;
+    };
+  };
+  auto classify_separately = [&](std::vector<Regex>& regexes) {
+    return [&] {
+      size_t sum = 0;
+      for (const string& row : rows)
+        for (size_t index = 0; index < regexes.size(); index++)
+          if (regexes[index].Matches(row)) sum += index;
+      return sum;
+    };
+  };
+  RegexSet interpreted_set(kClassifiers);
+  RegexSet jit_set(kClassifiers, 0, Regex::JIT);
+  std::vector<Regex> interpreted_classifiers, jit_classifiers;
+  for (const string& pattern : kClassifiers) {
+    interpreted_classifiers.emplace_back(pattern);
+    jit_classifiers.emplace_back(pattern, 0, Regex::JIT);
+  }
+
+  const size_t interpreted_matches =
+      Report("Matches interpreted", count_matches(interpreted));
+  const size_t jit_matches = Report("Matches jit", count_matches(jit));
+  const size_t interpreted_words_found =
+      Report("Scan interpreted", count_words(interpreted_words));
+  const size_t jit_words_found = Report("Scan jit", count_words(jit_words));
+  const size_t interpreted_set_sum =
+      Report("RegexSet interpreted", classify_set(interpreted_set));
+  const size_t jit_set_sum = Report("RegexSet jit", classify_set(jit_set));
+  const size_t interpreted_separate_sum =
+      Report("Regex each interpreted",
+             classify_separately(interpreted_classifiers));
+  const size_t jit_separate_sum =
+      Report("Regex each jit", classify_separately(jit_classifiers));
+
+  if (interpreted_matches != jit_matches ||
+      interpreted_words_found != jit_words_found ||
+      interpreted_set_sum != jit_set_sum ||
+      interpreted_set_sum != interpreted_separate_sum ||
+      interpreted_set_sum != jit_separate_sum) {
+    std::cerr << "engines disagree" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// pcre2 helpers shared by Regex and RegexSet.
+
+#include "core/regex.h"
+
+string Pcre2ErrorMessage(int errorcode);
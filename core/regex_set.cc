@@ -0,0 +1,125 @@
+#include "core/regex_set.h"
+
+#include "core/must.h"
+#include "core/regex_private.h"
+
+namespace {
+
+uint32 PatternInfo(const pcre2_code* code, uint32 what) {
+  uint32 value;
+  const int result = pcre2_pattern_info(code, what, &value);
+  if (result != 0) FAIL("pcre2_pattern_info: ", Pcre2ErrorMessage(result));
+  return value;
+}
+
+// Adds unit to set, along with the other case of an ASCII letter, which is
+// all that a caseless pattern can match in its place.
+void AddCodeUnit(std::bitset<256>& set, uint32 unit) {
+  set[unit] = true;
+  if (unit >= 'a' && unit <= 'z') set[unit - 'a' + 'A'] = true;
+  if (unit >= 'A' && unit <= 'Z') set[unit - 'A' + 'a'] = true;
+}
+
+}  // namespace
+
+RegexSet::RegexSet(const std::vector<string>& patterns, uint32 options,
+                   Regex::Engine engine) {
+  // The bytes each pattern needs, before they are given bits.
+  std::vector<std::bitset<256>> firsts, requireds;
+  std::bitset<256> wanted;
+  regexes_.reserve(patterns.size());
+  for (const string& pattern : patterns) {
+    regexes_.emplace_back(pattern, options, engine);
+    const pcre2_code* code = regexes_.back().code_.get();
+
+    std::bitset<256> first, required;
+    const uint32 first_code_type = PatternInfo(code, PCRE2_INFO_FIRSTCODETYPE);
+    if (first_code_type == 1) {
+      AddCodeUnit(first, PatternInfo(code, PCRE2_INFO_FIRSTCODEUNIT));
+    } else if (first_code_type == 0) {
+      const uint8* bitmap;
+      const int result =
+          pcre2_pattern_info(code, PCRE2_INFO_FIRSTBITMAP, &bitmap);
+      if (result != 0)
+        FAIL("pcre2_pattern_info: ", Pcre2ErrorMessage(result));
+      if (bitmap) {
+        for (size_t unit = 0; unit < 256; unit++)
+          first[unit] = (bitmap[unit / 8] >> (unit % 8)) & 1;
+      }
+    }
+    if (PatternInfo(code, PCRE2_INFO_LASTCODETYPE) == 1)
+      AddCodeUnit(required, PatternInfo(code, PCRE2_INFO_LASTCODEUNIT));
+
+    Screen screen;
+    screen.min_length = PatternInfo(code, PCRE2_INFO_MINLENGTH);
+    if (PatternInfo(code, PCRE2_INFO_ALLOPTIONS) & PCRE2_ANCHORED) {
+      screen.first_byte = first;
+      first.reset();
+    }
+    screens_.push_back(screen);
+    firsts.push_back(first);
+    requireds.push_back(required);
+    wanted |= first | required;
+  }
+
+  size_t next_bit = 0;
+  for (size_t byte = 0; byte < 256; byte++)
+    if (wanted[byte]) byte_bits_[byte] = 1 + next_bit++ % 63;
+  auto bits_of = [&](const std::bitset<256>& bytes) {
+    uint64 bits = 0;
+    for (size_t byte = 0; byte < 256; byte++)
+      if (bytes[byte]) bits |= uint64(1) << byte_bits_[byte];
+    return bits;
+  };
+  for (size_t i = 0; i < screens_.size(); i++) {
+    screens_[i].first = bits_of(firsts[i]);
+    screens_[i].required = bits_of(requireds[i]);
+  }
+}
+
+bool RegexSet::Screen::Admits(string_view subject, uint64 present) const {
+  if (subject.size() < min_length) return false;
+  if (first_byte.any() && (subject.empty() || !first_byte[uint8(subject[0])]))
+    return false;
+  return (first == 0 || (first & present) != 0) &&
+         (required == 0 || (required & present) != 0);
+}
+
+uint64 RegexSet::BytesOf(string_view subject) const {
+  uint64 present = 0;
+  for (char c : subject) present |= uint64(1) << byte_bits_[uint8(c)];
+  return present;
+}
+
+std::vector<string_view> RegexSet::CapturesOf(size_t index,
+                                              string_view subject) {
+  Regex& regex = regexes_[index];
+  const Regex::Results results =
+      regex.Match(subject, 0 /* startoffset */, 0 /* options */);
+  std::vector<string_view> captures;
+  if (results.size() == 0) return captures;
+  const size_t* ovector = pcre2_get_ovector_pointer(results.md_.get());
+  for (size_t group = 0; group <= regex.capture_count(); group++) {
+    if (group >= results.size() || ovector[2 * group] == PCRE2_UNSET)
+      captures.emplace_back();
+    else
+      captures.push_back(results[group]);
+  }
+  return captures;
+}
+
+std::vector<size_t> RegexSet::Matches(string_view subject) {
+  std::vector<size_t> indexes;
+  Matches(subject, indexes);
+  return indexes;
+}
+
+void RegexSet::Matches(string_view subject, std::vector<size_t>& indexes) {
+  indexes.clear();
+  const uint64 present = BytesOf(subject);
+  for (size_t index = 0; index < size(); index++) {
+    if (screens_[index].Admits(subject, present) &&
+        regexes_[index].Matches(subject))
+      indexes.push_back(index);
+  }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <bitset>
+#include <vector>
+
+#include "core/regex.h"
+
+// A set of patterns matched against a subject together.  Each pattern is
+// compiled as its own Regex, and pcre2 reports which bytes its matches can
+// start with and the last literal byte each must contain.  A single pass over
+// the subject notes which of those bytes it has, and only the patterns the
+// subject can satisfy are run, so that a pattern that can't match costs a
+// few instructions rather than a pcre2_match call (see regex_benchmark).
+class RegexSet {
+ public:
+  RegexSet(const std::vector<string>& patterns, uint32 options = 0,
+           Regex::Engine engine = Regex::INTERPRETER);
+
+  size_t size() const { return regexes_.size(); }
+
+  // Returns the indexes of the patterns that match somewhere in subject, in
+  // increasing order.
+  std::vector<size_t> Matches(string_view subject);
+
+  // Replaces the contents of indexes with the indexes Matches would return,
+  // so that one vector can be reused across subjects.
+  void Matches(string_view subject, std::vector<size_t>& indexes);
+
+  // Calls capture_function(index, captures) for each pattern that matches,
+  // in increasing order of index.  captures[0] is the leftmost match of that
+  // pattern and captures[n] its nth group, as Regex::Capture would report
+  // them, with unset groups empty.  Returns the number of patterns that
+  // matched.
+  template <typename F>
+  size_t Capture(string_view subject, F capture_function);
+
+ private:
+  // What every match of one pattern needs of the subject.  Zero or empty
+  // means no constraint.
+  struct Screen {
+    size_t min_length = 0;
+    // For an anchored pattern, the bytes the subject can start with.
+    std::bitset<256> first_byte;
+    // The byte_bits_ of the bytes the subject must have one of somewhere, to
+    // start a match or as the required byte.
+    uint64 first = 0;
+    uint64 required = 0;
+
+    bool Admits(string_view subject, uint64 present) const;
+  };
+
+  // The union of byte_bits_ of the bytes in subject.
+  uint64 BytesOf(string_view subject) const;
+
+  std::vector<string_view> CapturesOf(size_t index, string_view subject);
+
+  std::vector<Regex> regexes_;
+  std::vector<Screen> screens_;
+
+  // Bits 1 to 63 stand for the bytes some screen looks for, shared between
+  // several if there are more than 63, which only admits extra patterns.
+  // Bit 0 stands for every other byte.
+  uint8 byte_bits_[256] = {};
+};
+
+template <typename F>
+size_t RegexSet::Capture(string_view subject, F capture_function) {
+  const uint64 present = BytesOf(subject);
+  size_t matched = 0;
+  for (size_t index = 0; index < size(); index++) {
+    if (!screens_[index].Admits(subject, present)) continue;
+    std::vector<string_view> captures = CapturesOf(index, subject);
+    if (captures.empty()) continue;
+    capture_function(index, std::move(captures));
+    matched++;
+  }
+  return matched;
+}
@@ -0,0 +1,119 @@
+#include "core/regex_set.h"
+
+#include <map>
+
+#include "gtest/gtest.h"
+
+TEST(RegexSetTest, Matches) {
+  for (Regex::Engine engine : {Regex::INTERPRETER, Regex::JIT}) {
+    RegexSet set({R"(\d+)", "^<i>", "foo", "[!?]$"}, 0, engine);
+    EXPECT_EQ(4u, set.size());
+
+    EXPECT_EQ((std::vector<size_t>{}), set.Matches("bar"));
+    EXPECT_EQ((std::vector<size_t>{0, 2}), set.Matches("food 42"));
+    EXPECT_EQ((std::vector<size_t>{1, 3}), set.Matches("<i>Stop!"));
+    EXPECT_EQ((std::vector<size_t>{0, 1, 2, 3}), set.Matches("<i>foo 1?"));
+
+    std::vector<size_t> indexes = {7};
+    set.Matches("food 42", indexes);
+    EXPECT_EQ((std::vector<size_t>{0, 2}), indexes);
+    set.Matches("bar", indexes);
+    EXPECT_EQ((std::vector<size_t>{}), indexes);
+  }
+}
+
+TEST(RegexSetTest, Capture) {
+  RegexSet set({R"((\d+)-(\d+))", R"((\w+)@(\w+)?)", "(x)|(y)"});
+  std::map<size_t, std::vector<string>> captures;
+  size_t matched = set.Capture(
+      "call 555-1234 or bob@ and y",
+      [&](size_t index, std::vector<string_view> groups) {
+        for (string_view group : groups)
+          captures[index].push_back(group.to_string());
+      });
+  EXPECT_EQ(3u, matched);
+  EXPECT_EQ((std::vector<string>{"555-1234", "555", "1234"}), captures[0]);
+  EXPECT_EQ((std::vector<string>{"bob@", "bob", ""}), captures[1]);
+  EXPECT_EQ((std::vector<string>{"y", "", "y"}), captures[2]);
+}
+
+TEST(RegexSetTest, BadPattern) {
+  bool did_throw;
+  try {
+    RegexSet set({"ok", "bad["});
+    did_throw = false;
+  } catch (const std::exception& e) {
+    did_throw = true;
+  }
+  EXPECT_TRUE(did_throw);
+}
+
+TEST(RegexSetTest, SharesThreadStateWithRegex) {
+  RegexSet set({"a", "b"}, 0, Regex::JIT);
+  Regex regex("a(?C1)b", 0, Regex::JIT);
+  EXPECT_EQ((std::vector<size_t>{0, 1}), set.Matches("ab"));
+  EXPECT_TRUE(regex.Matches("ab"));
+  EXPECT_EQ((std::vector<size_t>{1}), set.Matches("b"));
+}
+
+TEST(RegexSetTest, References) {
+  // Each pattern keeps its own group numbers and names.
+  RegexSet set({"(?<n>x)y", "(?<n>a)(?&n)", R"((b)\1)", "(c)(?1)",
+                R"((?<n>d)\k<n>)", "e(?R)?f"});
+  EXPECT_EQ((std::vector<size_t>{1}), set.Matches("aa"));
+  EXPECT_EQ((std::vector<size_t>{}), set.Matches("ax"));
+  EXPECT_EQ((std::vector<size_t>{0, 2, 3}), set.Matches("xy bb cc"));
+  EXPECT_EQ((std::vector<size_t>{4, 5}), set.Matches("dd eeff"));
+}
+
+TEST(RegexSetTest, AgreesWithRegex) {
+  // Patterns whose first, required or minimum length information the
+  // screening relies on, and subjects that only just match them or not.
+  const std::vector<string> patterns = {
+      "said",        "(?i)said",    "^- ",         R"(\?$)",
+      R"(\d)",       "(?m)^x",      "(?<=a)b",     R"(a\Kb)",
+      "(cat|cow)",   "(?i)k",       "x*",          "[^a]{3}",
+      "\\x00z",      R"(\[[^]]*\])", "(?s).{4}",   "(*COMMIT)ab",
+      "^<i>",        "(?i)^said",   "^(a|b)c",     "(?s).*z",
+  };
+  const std::vector<string> subjects = {
+      "",    "said",  "SAID", "SaId", "sai",   "- x",  "-x",   "x?",
+      "?x",  "7",     "a\nx", "ab",   "b",     "cow",  "CAT",  "k",
+      "K",   "aaa",   "bbb",  "aab",  "z",     "[]",   "]x[",  "\n\n\n\n",
+      "xab", string("\0z", 2), "<i>", "x<i>", "Said", "bc",  "cbc", "a\nz",
+  };
+  for (uint32 options : {uint32(0), uint32(PCRE2_UTF)}) {
+    for (Regex::Engine engine : {Regex::INTERPRETER, Regex::JIT}) {
+      RegexSet set(patterns, options, engine);
+      std::vector<Regex> regexes;
+      for (const string& pattern : patterns)
+        regexes.emplace_back(pattern, options, engine);
+      std::vector<string> all_subjects = subjects;
+      if (options & PCRE2_UTF) {
+        // KELVIN SIGN and LATIN SMALL LETTER LONG S fold to k and s.
+        all_subjects.push_back("K");
+        all_subjects.push_back("ſAID");
+      }
+      for (const string& subject : all_subjects) {
+        std::vector<size_t> expected;
+        for (size_t i = 0; i < regexes.size(); i++)
+          if (regexes[i].Matches(subject)) expected.push_back(i);
+        EXPECT_EQ(expected, set.Matches(subject)) << subject;
+      }
+    }
+  }
+}
+
+TEST(RegexSetTest, ManyDistinctBytes) {
+  // More bytes than the screen has bits for, so some share one.
+  std::vector<string> patterns;
+  const char hex[] = "0123456789abcdef";
+  for (int byte = 1; byte < 256; byte++)
+    patterns.push_back(string("\\x") + hex[byte / 16] + hex[byte % 16] + "x");
+  RegexSet set(patterns);
+  for (int byte = 1; byte < 256; byte++) {
+    const string subject = string(1, char(byte)) + "x";
+    EXPECT_EQ((std::vector<size_t>{size_t(byte - 1)}), set.Matches(subject));
+    EXPECT_EQ((std::vector<size_t>{}), set.Matches(subject.substr(0, 1)));
+  }
+}
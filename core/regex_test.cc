@@ -43,3 +43,31 @@ TEST(RegexTest, Scan) {
       });
   EXPECT_EQ(hits, 3u);
 }
+
+TEST(RegexTest, Jit) {
+  Regex good_written(R"(^(\<i\>)?[-A-Za-z0-9 \.\,\?\'\!\"\n]+(\<\/i\>)?$)",
+                     0, Regex::JIT);
+
+  EXPECT_TRUE(good_written.Matches("Where are you going?"));
+  EXPECT_TRUE(good_written.Matches("<i>Not now.</i>"));
+  EXPECT_FALSE(good_written.Matches("[music playing]"));
+
+  Regex number_pattern(R"((\d+))", 0, Regex::JIT);
+  std::vector<string> captures;
+  size_t hits = number_pattern.Scan("12a345b6", [&](Regex::Results results) {
+    captures.push_back(results[1].to_string());
+  });
+  EXPECT_EQ(3u, hits);
+  EXPECT_EQ((std::vector<string>{"12", "345", "6"}), captures);
+}
+
+TEST(RegexTest, NestedMatches) {
+  Regex word_pattern(R"((\w+))");
+  Regex vowel_pattern(R"(([aeiou]))", 0, Regex::JIT);
+  std::vector<string> words;
+  word_pattern.Scan("the quick brown fox", [&](Regex::Results word) {
+    size_t vowels = vowel_pattern.Scan(word[1], [](Regex::Results) {});
+    words.push_back(word[1].to_string() + std::to_string(vowels));
+  });
+  EXPECT_EQ((std::vector<string>{"the1", "quick2", "brown1", "fox1"}), words);
+}
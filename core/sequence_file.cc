@@ -1,123 +1,566 @@
 #include "core/sequence_file.h"
 
+#include <exception>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <thread>
+#include <unistd.h>
+#include <zlib.h>
+#include <zstd.h>
 
 #include "core/must.h"
 
+static constexpr size_t kBlockSize = 1 << 20;
+
+// Compressed files start with kCompressedMagic.  Its first byte could only
+// begin a varint with a leading zero group, which pack_uint64 never writes,
+// so it can't be mistaken for the first record of an uncompressed file.
+// Each block that follows is the varint compressed size, the varint
+// uncompressed size, the little-endian CRC-32 of the compressed bytes, and
+// then the compressed bytes.  Records never straddle blocks.
+static constexpr char kCompressedMagic[8] = {'\x80', 'W', 'T', 'S',
+                                             'E',    'Q', 'Z', '1'};
+
+// The index trailer is the little-endian file offset of the index footer,
+// the little-endian CRC-32 of the footer and that offset, and kIndexMagic.
+// A file whose last bytes only look like a trailer fails the checksum and is
+// read as unindexed.
+static constexpr char kIndexMagic[8] = {'W', 'T', 'S', 'E', 'Q', 'I', 'D', 'X'};
+static constexpr size_t kIndexTrailerSize = 8 + 4 + sizeof(kIndexMagic);
+
+static int64 FileSize(int fd) {
+  struct stat s;
+  int fstat_result = fstat(fd, &s);
+  if (fstat_result != 0) THROW_ERRNO("fstat");
+  return int64(s.st_size);
+}
+
+static void PreadFully(int fd, void* buf, size_t len, int64 offset) {
+  char* ptr = static_cast<char*>(buf);
+  const char* end = ptr + len;
+  while (ptr < end) {
+    ssize_t pread_result = pread(fd, ptr, end - ptr, offset);
+    if (pread_result < 0) THROW_ERRNO("pread");
+    if (pread_result == 0) FAIL("Unexpected end-of-stream.");
+    ptr += pread_result;
+    offset += pread_result;
+  }
+}
+
+static uint32 BlockChecksum(const void* buf, size_t len) {
+  return crc32(0, static_cast<const Bytef*>(buf), len);
+}
+
+// Returns nullopt unless the file ends with a valid index trailer.
+static optional<SequenceIndex> ReadIndex(int fd) {
+  const int64 file_size = FileSize(fd);
+  if (file_size < int64(kIndexTrailerSize)) return nullopt;
+
+  char trailer[kIndexTrailerSize];
+  PreadFully(fd, trailer, kIndexTrailerSize, file_size - kIndexTrailerSize);
+  if (std::memcmp(trailer + 12, kIndexMagic, sizeof(kIndexMagic)) != 0)
+    return nullopt;
+
+  uint64 footer_begin = 0;
+  for (int i = 7; i >= 0; i--)
+    footer_begin = (footer_begin << 8) | uint8(trailer[i]);
+  uint32 checksum = 0;
+  for (int i = 11; i >= 8; i--) checksum = (checksum << 8) | uint8(trailer[i]);
+  const uint64 footer_end = file_size - kIndexTrailerSize;
+  if (footer_begin > footer_end) return nullopt;
+
+  string footer(footer_end - footer_begin, '\0');
+  PreadFully(fd, &footer[0], footer.size(), footer_begin);
+  footer.append(trailer, 8);
+  if (BlockChecksum(footer.data(), footer.size()) != checksum) return nullopt;
+  footer.resize(footer.size() - 8);
+
+  size_t pos = 0;
+  auto next_integer = [&]() -> int64 {
+    optional<uint64> n = unpack_uint64([&]() -> optional<uint8> {
+      if (pos == footer.size()) FAIL("corrupt sequence file index");
+      return uint8(footer[pos++]);
+    });
+    return int64(*n);
+  };
+
+  SequenceIndex index;
+  index.data_size = footer_begin;
+  index.interval = next_integer();
+  index.records = next_integer();
+  const int64 noffsets = next_integer();
+  MUST_GT(index.interval, 0, "corrupt sequence file index");
+  MUST_EQ((index.records + index.interval - 1) / index.interval, noffsets,
+          "corrupt sequence file index");
+  index.offsets.reserve(noffsets);
+  for (int64 i = 0; i < noffsets; i++) {
+    index.offsets.push_back(next_integer());
+    MUST_LE(index.offsets.back(), index.data_size,
+            "corrupt sequence file index");
+  }
+  MUST_EQ(pos, footer.size(), "corrupt sequence file index");
+  return index;
+}
+
 SequenceWriter::SequenceWriter(const filesystem::path& pathname,
-                               FileWriteMode mode)
-    : fd_(open(pathname.string().c_str(), O_WRONLY | O_CREAT | O_APPEND |
-                                              (mode == OVERWRITE ? O_TRUNC : 0),
-               S_IRUSR | S_IWUSR)) {
+                               FileWriteMode mode,
+                               SequenceCompression compression,
+                               int64 index_interval)
+    : fd_(open(pathname.string().c_str(),
+               (mode == OVERWRITE ? O_WRONLY | O_TRUNC : O_RDWR) | O_CREAT |
+                   O_APPEND,
+               S_IRUSR | S_IWUSR)),
+      compression_(compression),
+      index_interval_(index_interval) {
   if (fd_ == -1) THROW_ERRNO("open ", pathname);
+  MUST_GE(index_interval, 0);
+  buffer_.reserve(kBlockSize);
+
+  if (mode == APPEND) {
+    // An existing index footer is cut off and rewritten on close, so that
+    // appended records land directly after the old ones.
+    optional<SequenceIndex> index = ReadIndex(fd_);
+    if (index) {
+      int ftruncate_result = ftruncate(fd_, index->data_size);
+      if (ftruncate_result != 0) THROW_ERRNO("ftruncate ", pathname);
+      index_interval_ = index->interval;
+      records_ = index->records;
+      index_offsets_ = std::move(index->offsets);
+    } else if (index_interval_ != 0) {
+      MUST_EQ(0, FileSize(fd_), "cannot index an existing unindexed file ",
+              pathname);
+    }
+    written_ = FileSize(fd_);
+    if (written_ > 0) {
+      char magic[sizeof(kCompressedMagic)] = {};
+      PreadFully(fd_, magic, std::min<int64>(sizeof(magic), written_), 0);
+      const bool compressed =
+          std::memcmp(magic, kCompressedMagic, sizeof(magic)) == 0;
+      compression_ = compressed ? ZSTD : UNCOMPRESSED;
+    }
+  }
+
+  if (compression_ == ZSTD && written_ == 0)
+    WriteFully(kCompressedMagic, sizeof(kCompressedMagic));
 }
 
-SequenceWriter::SequenceWriter(SequenceWriter&& that) : fd_(that.fd_) {
+SequenceWriter::SequenceWriter(SequenceWriter&& that)
+    : fd_(that.fd_),
+      compression_(that.compression_),
+      buffer_(std::move(that.buffer_)),
+      compressed_(std::move(that.compressed_)),
+      written_(that.written_),
+      index_interval_(that.index_interval_),
+      records_(that.records_),
+      index_offsets_(std::move(that.index_offsets_)) {
   that.fd_ = -1;
 }
 
 SequenceWriter& SequenceWriter::operator=(SequenceWriter&& that) {
-  fd_ = that.fd_;
-  that.fd_ = -1;
+  if (this != &that) {
+    Close();
+    fd_ = that.fd_;
+    compression_ = that.compression_;
+    buffer_ = std::move(that.buffer_);
+    compressed_ = std::move(that.compressed_);
+    written_ = that.written_;
+    index_interval_ = that.index_interval_;
+    records_ = that.records_;
+    index_offsets_ = std::move(that.index_offsets_);
+    that.fd_ = -1;
+  }
   return *this;
 }
 
-SequenceWriter::~SequenceWriter() {
+SequenceWriter::~SequenceWriter() { Close(); }
+
+void SequenceWriter::Close() {
   if (fd_ != -1) {
+    Flush();
+    if (index_interval_ != 0) WriteIndex();
     int close_result = close(fd_);
+    fd_ = -1;
     if (close_result != 0) THROW_ERRNO("close");
   }
 }
 
-void SequenceWriter::WriteData(const void* buf, size_t len) {
+void SequenceWriter::WriteIndex() {
+  const uint64 footer_begin = written_;
+  string footer = pack_uint64(index_interval_) + pack_uint64(records_) +
+                  pack_uint64(index_offsets_.size());
+  for (int64 offset : index_offsets_) footer += pack_uint64(offset);
+  for (int i = 0; i < 8; i++) footer += char((footer_begin >> (8 * i)) & 0xFF);
+  const uint32 checksum = BlockChecksum(footer.data(), footer.size());
+  for (int i = 0; i < 4; i++) footer += char((checksum >> (8 * i)) & 0xFF);
+  footer.append(kIndexMagic, sizeof(kIndexMagic));
+  WriteFully(footer.data(), footer.size());
+}
+
+void SequenceWriter::WriteFully(const void* buf, size_t len) {
   const char* p = (const char*)buf;
   const char* const end = p + len;
   while (p < end) {
-    ssize_t write_result = write(fd_, buf, end - p);
+    ssize_t write_result = write(fd_, p, end - p);
     if (write_result < 0) THROW_ERRNO("write");
     p += write_result;
   }
+  written_ += len;
+}
+
+void SequenceWriter::Flush() {
+  if (buffer_.empty()) return;
+  if (compression_ == UNCOMPRESSED) {
+    WriteFully(buffer_.data(), buffer_.size());
+    buffer_.clear();
+    return;
+  }
+
+  compressed_.resize(ZSTD_compressBound(buffer_.size()));
+  const size_t compressed_size =
+      ZSTD_compress(compressed_.data(), compressed_.size(), buffer_.data(),
+                    buffer_.size(), ZSTD_CLEVEL_DEFAULT);
+  if (ZSTD_isError(compressed_size))
+    FAIL("ZSTD_compress: ", ZSTD_getErrorName(compressed_size));
+
+  string header = pack_uint64(compressed_size) + pack_uint64(buffer_.size());
+  const uint32 checksum = BlockChecksum(compressed_.data(), compressed_size);
+  for (int i = 0; i < 4; i++) header += char((checksum >> (8 * i)) & 0xFF);
+  WriteFully(header.data(), header.size());
+  WriteFully(compressed_.data(), compressed_size);
+  buffer_.clear();
+}
+
+// Uncompressed records may be split across writes, but a compressed block
+// must hold whole records, so in that case only EndRecord flushes.
+void SequenceWriter::WriteData(const void* buf, size_t len) {
+  if (compression_ == UNCOMPRESSED && buffer_.size() + len > kBlockSize) {
+    Flush();
+    if (len >= kBlockSize) {
+      WriteFully(buf, len);
+      return;
+    }
+  }
+  const char* p = (const char*)buf;
+  buffer_.insert(buffer_.end(), p, p + len);
+}
+
+void SequenceWriter::StartRecord() {
+  if (index_interval_ != 0 && records_ % index_interval_ == 0) {
+    // Indexed records of a compressed file start a fresh block.
+    if (compression_ == ZSTD) Flush();
+    index_offsets_.push_back(written_ + buffer_.size());
+  }
+  records_++;
+}
+
+void SequenceWriter::EndRecord() {
+  if (buffer_.size() >= kBlockSize) Flush();
 }
 
 void SequenceWriter::WriteString(string_view value) {
-  std::string i = pack_bigint(value.size());
-  WriteData(i.data(), i.size());
+  StartRecord();
+  char prefix[kMaxPackedUint64Size];
+  WriteData(prefix, pack_uint64(value.size(), prefix));
   WriteData(value.data(), value.size());
+  EndRecord();
 }
 
 void SequenceWriter::WriteMessage(const protobuf::Message& message) {
-  std::string s;
-  if (!message.SerializeToString(&s)) {
-    FAIL("Unabled to serialize: ", message.DebugString());
+  if (!message.IsInitialized()) {
+    FAIL("Unable to serialize: ", message.DebugString());
   }
-  WriteString(s);
+  StartRecord();
+  const size_t message_size = message.ByteSizeLong();
+  char prefix[kMaxPackedUint64Size];
+  WriteData(prefix, pack_uint64(message_size, prefix));
+
+  // Serialize straight into the block buffer rather than via a temporary.
+  if (compression_ == UNCOMPRESSED &&
+      buffer_.size() + message_size > kBlockSize)
+    Flush();
+  const size_t offset = buffer_.size();
+  buffer_.resize(offset + message_size);
+  message.SerializeWithCachedSizesToArray((uint8*)buffer_.data() + offset);
+  EndRecord();
 }
 
-SequenceReader::SequenceReader(const filesystem::path& pathname)
-    : fd_(open(pathname.string().c_str(), O_RDONLY)) {
+SequenceReader::SequenceReader(const filesystem::path& pathname,
+                               SequenceReadMode mode)
+    : pathname_(pathname),
+      fd_(open(pathname.string().c_str(), O_RDONLY)),
+      mode_(mode) {
   if (fd_ == -1) THROW_ERRNO("open ", pathname);
+
+  index_ = ReadIndex(fd_);
+  data_size_ = index_ ? index_->data_size : FileSize(fd_);
+
+  if (mode_ == MMAP) {
+    map_size_ = size_t(data_size_);
+    if (map_size_ > 0) {
+      void* map = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+      if (map == MAP_FAILED) THROW_ERRNO("mmap ", pathname);
+      map_ = static_cast<char*>(map);
+      madvise(map_, map_size_, MADV_SEQUENTIAL);
+    }
+    pos_ = map_;
+    end_ = map_ + map_size_;
+  } else {
+    buffer_.resize(kBlockSize);
+    pos_ = end_ = buffer_.data();
+  }
+
+  if (Fill(pos_, end_, sizeof(kCompressedMagic)) &&
+      std::memcmp(pos_, kCompressedMagic, sizeof(kCompressedMagic)) == 0) {
+    compressed_ = true;
+    raw_pos_ = pos_ + sizeof(kCompressedMagic);
+    raw_end_ = end_;
+    pos_ = end_ = block_.data();
+  }
 }
 
-SequenceReader::SequenceReader(SequenceReader&& that) : fd_(that.fd_) {
+SequenceReader::SequenceReader(SequenceReader&& that)
+    : pathname_(std::move(that.pathname_)),
+      fd_(that.fd_),
+      mode_(that.mode_),
+      index_(std::move(that.index_)),
+      data_size_(that.data_size_),
+      file_pos_(that.file_pos_),
+      map_(that.map_),
+      map_size_(that.map_size_),
+      buffer_(std::move(that.buffer_)),
+      pos_(that.pos_),
+      end_(that.end_),
+      compressed_(that.compressed_),
+      block_(std::move(that.block_)),
+      raw_pos_(that.raw_pos_),
+      raw_end_(that.raw_end_) {
   that.fd_ = -1;
+  that.map_ = nullptr;
+  that.pos_ = that.end_ = nullptr;
 }
 
 SequenceReader& SequenceReader::operator=(SequenceReader&& that) {
-  fd_ = that.fd_;
-  that.fd_ = -1;
+  if (this != &that) {
+    Close();
+    pathname_ = std::move(that.pathname_);
+    fd_ = that.fd_;
+    mode_ = that.mode_;
+    index_ = std::move(that.index_);
+    data_size_ = that.data_size_;
+    file_pos_ = that.file_pos_;
+    map_ = that.map_;
+    map_size_ = that.map_size_;
+    buffer_ = std::move(that.buffer_);
+    pos_ = that.pos_;
+    end_ = that.end_;
+    compressed_ = that.compressed_;
+    block_ = std::move(that.block_);
+    raw_pos_ = that.raw_pos_;
+    raw_end_ = that.raw_end_;
+    that.fd_ = -1;
+    that.map_ = nullptr;
+    that.pos_ = that.end_ = nullptr;
+  }
   return *this;
 }
 
-SequenceReader::~SequenceReader() {
+SequenceReader::~SequenceReader() { Close(); }
+
+void SequenceReader::Close() {
+  if (map_) {
+    int munmap_result = munmap(map_, map_size_);
+    map_ = nullptr;
+    if (munmap_result != 0) THROW_ERRNO("munmap");
+  }
   if (fd_ != -1) {
     int close_result = close(fd_);
+    fd_ = -1;
     if (close_result != 0) THROW_ERRNO("close");
   }
 }
 
-void SequenceReader::ReadData(void* buf, size_t len) {
-  if (len == 0) return;
-  char* ptr = static_cast<char*>(buf);
-  const char* end = ptr + len;
-  while (ptr < end) {
-    ssize_t received_bytes = read(fd_, ptr, end - ptr);
-    if (received_bytes < 0) THROW_ERRNO("read");
-    if (received_bytes == 0) FAIL("Unexpected end-of-stream.");
-    ptr += received_bytes;
-  }
-}
-
-optional<bigint> SequenceReader::ReadInteger() {
-  return unpack_bigint([&]() -> optional<uint8> {
-    uint8 m;
-    ssize_t read_result = read(fd_, &m, 1);
-    if (read_result == 0)
-      return nullopt;
-    else if (read_result == -1)
-      THROW_ERRNO("read");
-    else
-      return m;
+// Ensures at least len bytes of the current record data are available at
+// pos_.  Returns false if the record data ends first.
+bool SequenceReader::Available(size_t len) {
+  if (compressed_) return size_t(end_ - pos_) >= len;
+  return Fill(pos_, end_, len);
+}
+
+// Ensures at least len bytes of the file are available at pos, refilling the
+// buffer from the file if necessary.  Returns false if the data ends first.
+bool SequenceReader::Fill(const char*& pos, const char*& end, size_t len) {
+  if (size_t(end - pos) >= len) return true;
+  if (mode_ == MMAP) return false;
+
+  const size_t remaining = end - pos;
+  std::memmove(buffer_.data(), pos, remaining);
+  if (buffer_.size() < len) buffer_.resize(std::max(len, 2 * buffer_.size()));
+
+  char* const begin = buffer_.data();
+  char* fill = begin + remaining;
+  while (size_t(fill - begin) < len && file_pos_ < data_size_) {
+    const size_t want = std::min<int64>(begin + buffer_.size() - fill,
+                                        data_size_ - file_pos_);
+    ssize_t read_result = pread(fd_, fill, want, file_pos_);
+    if (read_result < 0) THROW_ERRNO("read");
+    if (read_result == 0) break;
+    fill += read_result;
+    file_pos_ += read_result;
+  }
+  pos = begin;
+  end = fill;
+  return size_t(end - pos) >= len;
+}
+
+// Loads the next compressed block into block_.  Returns false at the end of
+// the record data.
+bool SequenceReader::ReadBlock() {
+  auto read_raw_integer = [&]() {
+    return unpack_uint64([&]() -> optional<uint8> {
+      if (!Fill(raw_pos_, raw_end_, 1)) return nullopt;
+      return uint8(*raw_pos_++);
+    });
+  };
+  optional<uint64> compressed_size = read_raw_integer();
+  if (!compressed_size) return false;
+  optional<uint64> uncompressed_size = read_raw_integer();
+  MUST(uncompressed_size, "Unexpected end-of-stream.");
+  const size_t compressed_len = size_t(*compressed_size);
+  const size_t uncompressed_len = size_t(*uncompressed_size);
+
+  if (!Fill(raw_pos_, raw_end_, 4 + compressed_len))
+    FAIL("Unexpected end-of-stream.");
+  uint32 checksum = 0;
+  for (int i = 3; i >= 0; i--) checksum = (checksum << 8) | uint8(raw_pos_[i]);
+  raw_pos_ += 4;
+  MUST_EQ(checksum, BlockChecksum(raw_pos_, compressed_len),
+          "block checksum mismatch in ", pathname_);
+
+  block_.resize(uncompressed_len);
+  const size_t decompress_result = ZSTD_decompress(
+      block_.data(), block_.size(), raw_pos_, compressed_len);
+  if (ZSTD_isError(decompress_result))
+    FAIL("ZSTD_decompress: ", ZSTD_getErrorName(decompress_result));
+  MUST_EQ(uncompressed_len, decompress_result);
+  raw_pos_ += compressed_len;
+
+  pos_ = block_.data();
+  end_ = pos_ + block_.size();
+  return true;
+}
+
+optional<uint64> SequenceReader::ReadInteger() {
+  if (compressed_) {
+    while (pos_ == end_)
+      if (!ReadBlock()) return nullopt;
+  }
+  // Decode in place when the longest possible integer is already buffered.
+  if (Available(kMaxPackedUint64Size)) {
+    uint64 n = 0;
+    const char* next = unpack_uint64(pos_, end_, n);
+    MUST(next, "packed integer too long");
+    pos_ = next;
+    return n;
+  }
+  return unpack_uint64([&]() -> optional<uint8> {
+    if (!Available(1)) return nullopt;
+    return uint8(*pos_++);
   });
 }
 
-optional<string> SequenceReader::ReadString() {
-  optional<bigint> string_length = ReadInteger();
+optional<string_view> SequenceReader::ReadView() {
+  optional<uint64> string_length = ReadInteger();
   if (!string_length) return nullopt;
-  MUST_LE(*string_length, std::numeric_limits<size_t>::max());
-  string result(size_t(*string_length), '\0');
-  ReadData(&result[0], result.size());
+  const size_t len = size_t(*string_length);
+  if (!Available(len)) FAIL("Unexpected end-of-stream.");
+  string_view result(pos_, len);
+  pos_ += len;
   return result;
 }
 
+optional<string> SequenceReader::ReadString() {
+  optional<string_view> view = ReadView();
+  if (!view) return nullopt;
+  return view->to_string();
+}
+
 [[gnu::warn_unused_result]] bool SequenceReader::ReadMessage(
     protobuf::Message& message) {
-  optional<string> message_string = ReadString();
-  if (!message_string) return false;
-  const bool parse_success = message.ParseFromString(*message_string);
+  optional<string_view> message_view = ReadView();
+  if (!message_view) return false;
+  MUST_LE(message_view->size(), size_t(std::numeric_limits<int>::max()));
+  const bool parse_success =
+      message.ParseFromArray(message_view->data(), int(message_view->size()));
   if (!parse_success) {
-    FAIL("ParseFromString failed.");
+    FAIL("ParseFromArray failed.");
   }
   return true;
 }
+
+int64 SequenceReader::RecordCount() const {
+  MUST(index_, pathname_, " has no index");
+  return index_->records;
+}
+
+void SequenceReader::SeekToOffset(int64 offset) {
+  MUST_LE(offset, data_size_);
+  const char*& pos = compressed_ ? raw_pos_ : pos_;
+  const char*& end = compressed_ ? raw_end_ : end_;
+  if (mode_ == MMAP) {
+    pos = map_ + offset;
+    end = map_ + map_size_;
+  } else {
+    file_pos_ = offset;
+    pos = end = buffer_.data();
+  }
+  if (compressed_) pos_ = end_ = block_.data();
+}
+
+void SequenceReader::Seek(int64 record_number) {
+  MUST(index_, pathname_, " has no index");
+  MUST_GE(record_number, 0);
+  MUST_LE(record_number, index_->records);
+  const size_t entry = size_t(record_number / index_->interval);
+  SeekToOffset(entry < index_->offsets.size() ? index_->offsets[entry]
+                                              : data_size_);
+  for (int64 i = entry * index_->interval; i < record_number; i++)
+    MUST(ReadView(), "Unexpected end-of-stream.");
+}
+
+void SequenceReader::ForEachRecordParallel(
+    size_t nthreads,
+    const std::function<void(int64 record_number, string_view record)>& fn) {
+  MUST_GT(nthreads, 0u);
+  const int64 records = RecordCount();
+  const int64 records_per_thread = (records + nthreads - 1) / nthreads;
+
+  std::vector<std::thread> threads;
+  std::vector<std::exception_ptr> errors(nthreads);
+
+  for (size_t i = 0; i < nthreads; i++) {
+    std::thread t([&](size_t index) {
+      try {
+        const int64 begin =
+            std::min<int64>(index * records_per_thread, records);
+        const int64 end = std::min(begin + records_per_thread, records);
+        SequenceReader reader(pathname_, mode_);
+        reader.Seek(begin);
+        for (int64 record_number = begin; record_number < end;
+             record_number++) {
+          optional<string_view> record = reader.ReadView();
+          MUST(record, "Unexpected end-of-stream.");
+          fn(record_number, *record);
+        }
+      } catch (...) {
+        errors[index] = std::current_exception();
+      }
+    }, i);
+    threads.push_back(std::move(t));
+  }
+
+  for (std::thread& t : threads) t.join();
+  for (const std::exception_ptr& error : errors)
+    if (error) std::rethrow_exception(error);
+}
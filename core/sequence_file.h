@@ -1,12 +1,41 @@
 #pragma once
 
 #include <boost/filesystem.hpp>
+#include <functional>
+#include <vector>
 
 #include "core/file_functions.h"
 
+// How a SequenceReader gets at the bytes of its file.  BUFFERED reads the
+// file in large blocks into a userspace buffer.  MMAP maps the whole file so
+// that ReadView can hand out records without copying them.
+enum SequenceReadMode { BUFFERED, MMAP };
+
+// How a SequenceWriter stores records.  ZSTD groups records into blocks of
+// about a megabyte that are compressed together and carry a CRC-32 of their
+// compressed bytes.  Readers detect the format from the file header.
+enum SequenceCompression { UNCOMPRESSED, ZSTD };
+
+// The optional footer of a sequence file: the file offset of every
+// interval'th record and the total number of records.  It follows the record
+// data and ends with a fixed-size, checksummed trailer, so a reader can find
+// it from the end of the file.
+struct SequenceIndex {
+  int64 data_size = 0;
+  int64 interval = 0;
+  int64 records = 0;
+  std::vector<int64> offsets;
+};
+
 class SequenceWriter {
  public:
-  SequenceWriter(const filesystem::path& pathname, FileWriteMode mode);
+  // If index_interval is non-zero an index footer recording the offset of
+  // every index_interval'th record is written when the writer is closed.
+  // Appending to an existing file keeps its compression and keeps its index
+  // up to date.
+  SequenceWriter(const filesystem::path& pathname, FileWriteMode mode,
+                 SequenceCompression compression = UNCOMPRESSED,
+                 int64 index_interval = 0);
   SequenceWriter(SequenceWriter&&);
   SequenceWriter& operator=(SequenceWriter&&);
   ~SequenceWriter();
@@ -14,11 +43,27 @@ class SequenceWriter {
   void WriteString(string_view s);
   void WriteMessage(const protobuf::Message& message);
 
+  // Records are buffered in userspace and written out in large blocks.
+  // Flush writes everything buffered so far to the file.  It is called
+  // automatically on destruction.
+  void Flush();
+
  private:
-  void WriteInteger(bigint n);
   void WriteData(const void* buf, size_t len);
+  void WriteFully(const void* buf, size_t len);
+  void StartRecord();
+  void EndRecord();
+  void WriteIndex();
+  void Close();
 
   int fd_;
+  SequenceCompression compression_;
+  std::vector<char> buffer_;
+  std::vector<char> compressed_;
+  int64 written_ = 0;
+  int64 index_interval_ = 0;
+  int64 records_ = 0;
+  std::vector<int64> index_offsets_;
 
   SequenceWriter(const SequenceWriter&) = delete;
   SequenceWriter& operator=(const SequenceWriter&) = delete;
@@ -26,7 +71,8 @@ class SequenceWriter {
 
 class SequenceReader {
  public:
-  SequenceReader(const filesystem::path& pathname);
+  SequenceReader(const filesystem::path& pathname,
+                 SequenceReadMode mode = BUFFERED);
   SequenceReader(SequenceReader&&);
   SequenceReader& operator=(SequenceReader&&);
   ~SequenceReader();
@@ -34,11 +80,51 @@ class SequenceReader {
   optional<string> ReadString();
   [[gnu::warn_unused_result]] bool ReadMessage(protobuf::Message& message);
 
+  // Returns the next record without copying it.  In BUFFERED mode, or if the
+  // file is compressed, the view is only valid until the next read.
+  // Otherwise in MMAP mode it is valid for the lifetime of the reader.
+  optional<string_view> ReadView();
+
+  // The remaining members require the file to have an index footer.
+  bool HasIndex() const { return bool(index_); }
+  int64 RecordCount() const;
+
+  // Positions the reader so that the next read returns record_number.
+  void Seek(int64 record_number);
+
+  // Splits the records into nthreads contiguous shards and calls fn on every
+  // record, with each shard scanned by its own thread and reader.  fn must be
+  // safe to call concurrently.  Does not move this reader.
+  void ForEachRecordParallel(
+      size_t nthreads,
+      const std::function<void(int64 record_number, string_view record)>& fn);
+
  private:
-  optional<bigint> ReadInteger();
-  void ReadData(void* buf, size_t len);
+  optional<uint64> ReadInteger();
+  bool Available(size_t len);
+  bool Fill(const char*& pos, const char*& end, size_t len);
+  bool ReadBlock();
+  void SeekToOffset(int64 offset);
+  void Close();
 
+  filesystem::path pathname_;
   int fd_;
+  SequenceReadMode mode_;
+  optional<SequenceIndex> index_;
+  int64 data_size_ = 0;
+  int64 file_pos_ = 0;
+  char* map_ = nullptr;
+  size_t map_size_ = 0;
+  std::vector<char> buffer_;
+  const char* pos_ = nullptr;
+  const char* end_ = nullptr;
+
+  // For compressed files pos_ and end_ walk the current decompressed block,
+  // and raw_pos_ and raw_end_ walk the file itself.
+  bool compressed_ = false;
+  std::vector<char> block_;
+  const char* raw_pos_ = nullptr;
+  const char* raw_end_ = nullptr;
 
   SequenceReader(const SequenceReader&) = delete;
   SequenceReader& operator=(const SequenceReader&) = delete;
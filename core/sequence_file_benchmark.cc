@@ -0,0 +1,134 @@
+#include <cmath>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "core/must.h"
+#include "core/sequence_file.h"
+#include "main/noargs.h"
+
+constexpr int64 kRecords = 1'000'000;
+constexpr size_t kRecordSize = 100;
+constexpr int64 kWaveRecords = 2'000;
+constexpr size_t kWaveSamples = 24'000;
+
+// The unbuffered paths SequenceWriter/SequenceReader used to take: one
+// write(2) per length prefix and payload, and one read(2) per varint byte.
+
+static void LegacyWrite(const filesystem::path& pathname) {
+  int fd = open(pathname.string().c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                S_IRUSR | S_IWUSR);
+  if (fd == -1) THROW_ERRNO("open ", pathname);
+  const string record(kRecordSize, 'x');
+  for (int64 i = 0; i < kRecords; i++) {
+    const string prefix = pack_bigint(record.size());
+    MUST_EQ(ssize_t(prefix.size()), write(fd, prefix.data(), prefix.size()));
+    MUST_EQ(ssize_t(record.size()), write(fd, record.data(), record.size()));
+  }
+  MUST_EQ(0, close(fd));
+}
+
+static int64 LegacyRead(const filesystem::path& pathname) {
+  int fd = open(pathname.string().c_str(), O_RDONLY);
+  if (fd == -1) THROW_ERRNO("open ", pathname);
+  int64 records = 0;
+  string record;
+  while (true) {
+    optional<bigint> len = unpack_bigint([&]() -> optional<uint8> {
+      uint8 m;
+      ssize_t read_result = read(fd, &m, 1);
+      if (read_result == -1) THROW_ERRNO("read");
+      if (read_result == 0) return nullopt;
+      return m;
+    });
+    if (!len) break;
+    record.resize(size_t(*len));
+    MUST_EQ(ssize_t(record.size()), read(fd, &record[0], record.size()));
+    records++;
+  }
+  MUST_EQ(0, close(fd));
+  return records;
+}
+
+static void BufferedWrite(const filesystem::path& pathname) {
+  SequenceWriter writer(pathname, OVERWRITE);
+  const string record(kRecordSize, 'x');
+  for (int64 i = 0; i < kRecords; i++) writer.WriteString(record);
+}
+
+static int64 BufferedRead(const filesystem::path& pathname,
+                          SequenceReadMode mode) {
+  SequenceReader reader(pathname, mode);
+  int64 records = 0;
+  while (reader.ReadView()) records++;
+  return records;
+}
+
+// Two seconds of 12kHz int16 PCM: a couple of tones and some noise, roughly
+// the shape of the waves inside audio::SpeechText records.
+static string MakeWave(int64 seed) {
+  string wave(kWaveSamples * sizeof(int16), '\0');
+  int16* samples = (int16*)&wave[0];
+  uint32 noise = uint32(seed) * 2654435761u + 1;
+  for (size_t i = 0; i < kWaveSamples; i++) {
+    noise = noise * 1664525u + 1013904223u;
+    const float64 t = float64(i) / 12000;
+    samples[i] = int16(4000 * std::sin(2 * M_PI * (220 + seed % 50) * t) +
+                       1500 * std::sin(2 * M_PI * 1700 * t) +
+                       int32(noise >> 27) - 16);
+  }
+  return wave;
+}
+
+static void WaveWrite(const filesystem::path& pathname,
+                      SequenceCompression compression,
+                      const std::vector<string>& waves) {
+  SequenceWriter writer(pathname, OVERWRITE, compression);
+  for (const string& wave : waves) writer.WriteString(wave);
+}
+
+static int64 WaveRead(const filesystem::path& pathname) {
+  SequenceReader reader(pathname, MMAP);
+  int64 bytes = 0;
+  while (optional<string_view> record = reader.ReadView())
+    bytes += record->size();
+  return bytes;
+}
+
+template <typename F>
+void Report(const string& name, F f, int64 records = kRecords) {
+  const float64 start = now_secs();
+  f();
+  const float64 elapsed = now_secs() - start;
+  std::cout << name << ": " << int64(records / elapsed) << " records/sec"
+            << std::endl;
+}
+
+void Main() {
+  const filesystem::path tmpfile =
+      filesystem::temp_directory_path() / filesystem::unique_path();
+
+  Report("legacy write", [&] { LegacyWrite(tmpfile); });
+  Report("buffered write", [&] { BufferedWrite(tmpfile); });
+  Report("legacy read", [&] { MUST_EQ(kRecords, LegacyRead(tmpfile)); });
+  Report("buffered read",
+         [&] { MUST_EQ(kRecords, BufferedRead(tmpfile, BUFFERED)); });
+  Report("mmap read", [&] { MUST_EQ(kRecords, BufferedRead(tmpfile, MMAP)); });
+
+  std::vector<string> waves;
+  for (int64 i = 0; i < kWaveRecords; i++) waves.push_back(MakeWave(i));
+  const int64 wave_bytes = kWaveRecords * kWaveSamples * sizeof(int16);
+  for (SequenceCompression compression : {UNCOMPRESSED, ZSTD}) {
+    const string name = compression == ZSTD ? "zstd" : "uncompressed";
+    Report(name + " wave write",
+           [&] { WaveWrite(tmpfile, compression, waves); }, kWaveRecords);
+    Report(name + " wave read",
+           [&] { MUST_EQ(wave_bytes, WaveRead(tmpfile)); }, kWaveRecords);
+    std::cout << name << " wave file: " << filesystem::file_size(tmpfile)
+              << " bytes" << std::endl;
+  }
+
+  filesystem::remove(tmpfile);
+}
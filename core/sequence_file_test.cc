@@ -51,3 +51,181 @@ TEST(SequenceFileTest, MultipleReadWrite) {
 
   filesystem::remove(tmpfile);
 }
+
+TEST(SequenceFileTest, MmapReadView) {
+  filesystem::path tmpfile =
+      filesystem::temp_directory_path() / filesystem::unique_path();
+
+  {
+    SequenceWriter writer(tmpfile, OVERWRITE);
+    for (int i = 0; i < 1000; i++) writer.WriteString(std::string(i, 'x'));
+  }
+  {
+    SequenceReader reader(tmpfile, MMAP);
+    std::vector<string_view> views;
+    for (int i = 0; i < 1000; i++) views.push_back(reader.ReadView().value());
+    EXPECT_FALSE(reader.ReadView());
+    for (int i = 0; i < 1000; i++) EXPECT_EQ(views[i], std::string(i, 'x'));
+  }
+
+  filesystem::remove(tmpfile);
+}
+
+TEST(SequenceFileTest, FlushAndLargeRecords) {
+  filesystem::path tmpfile =
+      filesystem::temp_directory_path() / filesystem::unique_path();
+
+  const std::string large(3 << 20, 'L');
+  {
+    SequenceWriter writer(tmpfile, OVERWRITE);
+    writer.WriteString("first");
+    writer.Flush();
+    {
+      SequenceReader reader(tmpfile);
+      EXPECT_EQ(reader.ReadString().value(), "first");
+      EXPECT_FALSE(reader.ReadString());
+    }
+    writer.WriteString(large);
+    writer.WriteString("last");
+  }
+  for (SequenceReadMode mode : {BUFFERED, MMAP}) {
+    SequenceReader reader(tmpfile, mode);
+    EXPECT_EQ(reader.ReadString().value(), "first");
+    EXPECT_EQ(reader.ReadString().value(), large);
+    EXPECT_EQ(reader.ReadString().value(), "last");
+    EXPECT_FALSE(reader.ReadString());
+  }
+
+  filesystem::remove(tmpfile);
+}
+
+TEST(SequenceFileTest, IndexedSeek) {
+  filesystem::path tmpfile =
+      filesystem::temp_directory_path() / filesystem::unique_path();
+
+  for (SequenceCompression compression : {UNCOMPRESSED, ZSTD}) {
+    {
+      SequenceWriter writer(tmpfile, OVERWRITE, compression, 7);
+      for (int i = 0; i < 500; i++) writer.WriteString(std::to_string(i));
+    }
+    {
+      SequenceWriter writer(tmpfile, APPEND);
+      for (int i = 500; i < 1000; i++) writer.WriteString(std::to_string(i));
+    }
+    for (SequenceReadMode mode : {BUFFERED, MMAP}) {
+      SequenceReader reader(tmpfile, mode);
+      ASSERT_TRUE(reader.HasIndex());
+      EXPECT_EQ(reader.RecordCount(), 1000);
+      for (int i : {999, 0, 7, 13, 500, 6}) {
+        reader.Seek(i);
+        EXPECT_EQ(reader.ReadString().value(), std::to_string(i));
+      }
+      reader.Seek(998);
+      EXPECT_EQ(reader.ReadString().value(), "998");
+      EXPECT_EQ(reader.ReadString().value(), "999");
+      EXPECT_FALSE(reader.ReadString());
+    }
+  }
+
+  filesystem::remove(tmpfile);
+}
+
+TEST(SequenceFileTest, UnindexedFileEndingLikeATrailer) {
+  filesystem::path tmpfile =
+      filesystem::temp_directory_path() / filesystem::unique_path();
+
+  // The record is itself a plausible trailer for a one byte footer.
+  const string record = string(12, '\0') + "WTSEQIDX";
+  {
+    SequenceWriter writer(tmpfile, OVERWRITE);
+    writer.WriteString(record);
+  }
+  {
+    SequenceReader reader(tmpfile);
+    EXPECT_FALSE(reader.HasIndex());
+    EXPECT_EQ(reader.ReadString().value(), record);
+    EXPECT_FALSE(reader.ReadString());
+  }
+  {
+    SequenceWriter writer(tmpfile, APPEND);
+    writer.WriteString("next");
+  }
+  {
+    SequenceReader reader(tmpfile);
+    EXPECT_EQ(reader.ReadString().value(), record);
+    EXPECT_EQ(reader.ReadString().value(), "next");
+    EXPECT_FALSE(reader.ReadString());
+  }
+
+  filesystem::remove(tmpfile);
+}
+
+TEST(SequenceFileTest, ForEachRecordParallel) {
+  filesystem::path tmpfile =
+      filesystem::temp_directory_path() / filesystem::unique_path();
+
+  {
+    SequenceWriter writer(tmpfile, OVERWRITE, UNCOMPRESSED, 16);
+    for (int i = 0; i < 10000; i++) writer.WriteString(std::to_string(i));
+  }
+  for (SequenceReadMode mode : {BUFFERED, MMAP}) {
+    SequenceReader reader(tmpfile, mode);
+    std::vector<int> seen(10000, 0);
+    reader.ForEachRecordParallel(
+        3, [&](int64 record_number, string_view record) {
+          EXPECT_EQ(record, std::to_string(record_number));
+          seen[record_number]++;
+        });
+    for (int count : seen) EXPECT_EQ(count, 1);
+  }
+
+  filesystem::remove(tmpfile);
+}
+
+TEST(SequenceFileTest, CompressedReadWrite) {
+  filesystem::path tmpfile =
+      filesystem::temp_directory_path() / filesystem::unique_path();
+
+  {
+    SequenceWriter writer(tmpfile, OVERWRITE, ZSTD);
+    for (int i = 0; i < 10000; i++) {
+      SequenceFileTestProto proto;
+      proto.set_data(std::string(i, char('a' + i % 26)));
+      proto.set_code(i);
+      writer.WriteMessage(proto);
+    }
+  }
+  for (SequenceReadMode mode : {BUFFERED, MMAP}) {
+    SequenceReader reader(tmpfile, mode);
+    for (int i = 0; i < 10000; i++) {
+      SequenceFileTestProto proto;
+      EXPECT_TRUE(reader.ReadMessage(proto));
+      EXPECT_EQ(proto.data(), std::string(i, char('a' + i % 26)));
+      EXPECT_EQ(proto.code(), i);
+    }
+    SequenceFileTestProto proto;
+    EXPECT_FALSE(reader.ReadMessage(proto));
+  }
+  EXPECT_LT(filesystem::file_size(tmpfile), 10000u * 10000u / 2 / 10);
+
+  filesystem::remove(tmpfile);
+}
+
+TEST(SequenceFileTest, CompressedChecksumMismatch) {
+  filesystem::path tmpfile =
+      filesystem::temp_directory_path() / filesystem::unique_path();
+
+  {
+    SequenceWriter writer(tmpfile, OVERWRITE, ZSTD);
+    for (int i = 0; i < 100; i++) writer.WriteString(std::to_string(i));
+  }
+  string contents = GetFileContents(tmpfile);
+  contents[contents.size() - 3] ^= 0x10;
+  SetFileContents(tmpfile, contents);
+  {
+    SequenceReader reader(tmpfile);
+    EXPECT_THROW(reader.ReadString(), std::exception);
+  }
+
+  filesystem::remove(tmpfile);
+}
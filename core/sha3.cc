@@ -0,0 +1,346 @@
+#include "core/sha3.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "core/must.h"
+
+namespace {
+
+constexpr uint64 kRoundConstants[24] = {
+    0x0000000000000001, 0x0000000000008082, 0x800000000000808A,
+    0x8000000080008000, 0x000000000000808B, 0x0000000080000001,
+    0x8000000080008081, 0x8000000000008009, 0x000000000000008A,
+    0x0000000000000088, 0x0000000080008009, 0x000000008000000A,
+    0x000000008000808B, 0x800000000000008B, 0x8000000000008089,
+    0x8000000000008003, 0x8000000000008002, 0x8000000000000080,
+    0x000000000000800A, 0x800000008000000A, 0x8000000080008081,
+    0x8000000000008080, 0x0000000080000001, 0x8000000080008008};
+
+// The rotation of lane x + 5y in the rho step.
+constexpr int kRotations[25] = {0,  1,  62, 28, 27, 36, 44, 6,  55,
+                                20, 3,  10, 43, 25, 39, 41, 45, 15,
+                                21, 8,  18, 2,  61, 56, 14};
+
+// Takes and returns vectors by reference: passing them by value would not
+// match the ABI of callers compiled without AVX.
+template <typename Lanes>
+__attribute__((always_inline)) inline void Rotate(Lanes &out, const Lanes &in,
+                                                  int n) {
+  out = n == 0 ? in : (in << n) | (in >> (64 - n));
+}
+
+// Keccak-f[1600] on the 25 lanes of a.  Lanes is either uint64, for a
+// single state, or a vector of uint64 holding the same lane of several
+// independent states, so one pass permutes all of them.  The loops are
+// unrolled so that every lane index and rotation is a constant and the state
+// stays in registers.
+template <typename Lanes>
+__attribute__((always_inline)) inline void KeccakF1600Lanes(Lanes *a) {
+  for (int round = 0; round < 24; round++) {
+    Lanes c[5], b[25];
+#pragma GCC unroll 5
+    for (int x = 0; x < 5; x++)
+      c[x] = a[x] ^ a[x + 5] ^ a[x + 10] ^ a[x + 15] ^ a[x + 20];
+#pragma GCC unroll 5
+    for (int x = 0; x < 5; x++) {
+      Lanes d;
+      Rotate(d, c[(x + 1) % 5], 1);
+      d ^= c[(x + 4) % 5];
+#pragma GCC unroll 5
+      for (int y = 0; y < 25; y += 5) a[x + y] ^= d;
+    }
+#pragma GCC unroll 5
+    for (int x = 0; x < 5; x++)
+#pragma GCC unroll 5
+      for (int y = 0; y < 5; y++)
+        Rotate(b[y + 5 * ((2 * x + 3 * y) % 5)], a[x + 5 * y],
+               kRotations[x + 5 * y]);
+#pragma GCC unroll 5
+    for (int y = 0; y < 25; y += 5)
+#pragma GCC unroll 5
+      for (int x = 0; x < 5; x++)
+        a[x + y] = b[x + y] ^ (~b[(x + 1) % 5 + y] & b[(x + 2) % 5 + y]);
+    a[0] ^= kRoundConstants[round];
+  }
+}
+
+// The largest rate, that of SHAKE128.
+constexpr size_t kMaxRateBytes = 168;
+
+}  // namespace
+
+void KeccakF1600(uint64 *state) { KeccakF1600Lanes(state); }
+
+Sha3Context::Sha3Context(unsigned int rate, uint8 delimited_suffix,
+                         size_t digest_size)
+    : rate_bytes_(rate / 8),
+      delimited_suffix_(delimited_suffix),
+      digest_size_(digest_size) {
+  std::memset(state_, 0, sizeof(state_));
+}
+
+void Sha3Context::Update(const void *input, size_t size) {
+  MUST(!squeezing_, "Sha3Context::Update after output");
+  const uint8 *in = (const uint8 *)input;
+
+  // Whole blocks are absorbed a lane at a time.
+  if (position_ == 0) {
+    while (size >= rate_bytes_) {
+      for (unsigned int i = 0; i < rate_bytes_; i += 8) {
+        uint64 lane;
+        std::memcpy(&lane, in + i, 8);
+        ((uint64 *)state_)[i / 8] ^= lane;
+      }
+      KeccakF1600_StatePermute(state_);
+      in += rate_bytes_;
+      size -= rate_bytes_;
+    }
+  }
+
+  while (size > 0) {
+    const size_t block_size = std::min<size_t>(size, rate_bytes_ - position_);
+    for (size_t i = 0; i < block_size; i++) state_[position_ + i] ^= in[i];
+    in += block_size;
+    size -= block_size;
+    position_ += block_size;
+    if (position_ == rate_bytes_) {
+      KeccakF1600_StatePermute(state_);
+      position_ = 0;
+    }
+  }
+}
+
+void Sha3Context::Pad() {
+  state_[position_] ^= delimited_suffix_;
+  if ((delimited_suffix_ & 0x80) != 0 && position_ == rate_bytes_ - 1)
+    KeccakF1600_StatePermute(state_);
+  state_[rate_bytes_ - 1] ^= 0x80;
+  KeccakF1600_StatePermute(state_);
+  position_ = 0;
+  squeezing_ = true;
+}
+
+void Sha3Context::Extract(void *output, size_t size) {
+  uint8 *out = (uint8 *)output;
+  while (size > 0) {
+    if (position_ == rate_bytes_) {
+      KeccakF1600_StatePermute(state_);
+      position_ = 0;
+    }
+    const size_t block_size = std::min<size_t>(size, rate_bytes_ - position_);
+    std::memcpy(out, state_ + position_, block_size);
+    out += block_size;
+    size -= block_size;
+    position_ += block_size;
+  }
+}
+
+void Sha3Context::Final(void *output) {
+  MUST_NE(digest_size_, 0u, "Sha3Context::Final on SHAKE; use Squeeze");
+  MUST(!squeezing_, "Sha3Context::Final called twice");
+  Pad();
+  Extract(output, digest_size_);
+}
+
+void Sha3Context::Squeeze(void *output, size_t size) {
+  MUST_EQ(digest_size_, 0u, "Sha3Context::Squeeze on SHA-3; use Final");
+  if (!squeezing_) Pad();
+  Extract(output, size);
+}
+
+void HashFile(const filesystem::path &path, Sha3Context &context) {
+  constexpr size_t kBlockSize = 1 << 20;
+  const int fd = open(path.string().c_str(), O_RDONLY);
+  if (fd == -1) THROW_ERRNO("open(", path, ")");
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  std::vector<uint8> buffer(kBlockSize);
+  while (true) {
+    const ssize_t bytes_read = read(fd, buffer.data(), buffer.size());
+    if (bytes_read == -1) {
+      if (errno == EINTR) continue;
+      const int read_errno = errno;
+      close(fd);
+      errno = read_errno;
+      THROW_ERRNO("read(", path, ")");
+    }
+    if (bytes_read == 0) break;
+    context.Update(buffer.data(), bytes_read);
+  }
+  if (close(fd) != 0) THROW_ERRNO("close(", path, ")");
+}
+
+namespace {
+
+// Where a batch of SHA-3 computations starts from: a state shared by all of
+// them with position bytes of the current block already absorbed.
+struct BatchStart {
+  const uint8 *state;
+  size_t rate_bytes;
+  size_t position;
+  uint8 delimited_suffix;
+  size_t digest_size;
+};
+
+// XORs one block of each of kWidth messages into the state and permutes it,
+// lane i of every vector belonging to message i.
+template <typename Lanes, size_t kWidth>
+__attribute__((always_inline)) inline void AbsorbLanes(
+    Lanes *a, size_t rate_bytes, const uint8 *const *blocks) {
+  for (size_t lane = 0; lane < rate_bytes / 8; lane++) {
+    uint64 gathered[kWidth];
+    for (size_t i = 0; i < kWidth; i++)
+      std::memcpy(&gathered[i], blocks[i] + 8 * lane, 8);
+    Lanes lanes;
+    std::memcpy(&lanes, gathered, sizeof(lanes));
+    a[lane] ^= lanes;
+  }
+  KeccakF1600Lanes(a);
+}
+
+// Finishes kWidth computations from start, appending size bytes of input to
+// each.  Input bytes are numbered from the start of the current block, so
+// the first start.position of them are zeros that leave the state as is.
+template <typename Lanes, size_t kWidth>
+__attribute__((always_inline)) inline void FinalLanes(
+    const BatchStart &start, const uint8 *const *inputs, size_t size,
+    uint8 *const *outputs) {
+  const size_t rate_bytes = start.rate_bytes;
+  Lanes a[25];
+  for (size_t lane = 0; lane < 25; lane++) {
+    uint64 gathered[kWidth];
+    for (size_t i = 0; i < kWidth; i++)
+      std::memcpy(&gathered[i], start.state + 8 * lane, 8);
+    std::memcpy(&a[lane], gathered, sizeof(a[lane]));
+  }
+
+  uint8 block[kWidth][kMaxRateBytes];
+  const uint8 *blocks[kWidth];
+  const size_t end = start.position + size;
+  size_t pos = 0;
+  for (; pos + rate_bytes <= end; pos += rate_bytes) {
+    for (size_t i = 0; i < kWidth; i++) {
+      if (pos >= start.position) {
+        blocks[i] = inputs[i] + (pos - start.position);
+      } else {
+        std::memset(block[i], 0, start.position);
+        std::memcpy(block[i] + start.position, inputs[i],
+                    rate_bytes - start.position);
+        blocks[i] = block[i];
+      }
+    }
+    AbsorbLanes<Lanes, kWidth>(a, rate_bytes, blocks);
+  }
+
+  const size_t offset = std::max(pos, start.position) - pos;
+  for (size_t i = 0; i < kWidth; i++) {
+    std::memset(block[i], 0, rate_bytes);
+    std::memcpy(block[i] + offset, inputs[i] + (pos + offset - start.position),
+                end - pos - offset);
+    block[i][end - pos] ^= start.delimited_suffix;
+    block[i][rate_bytes - 1] ^= 0x80;
+    blocks[i] = block[i];
+  }
+  AbsorbLanes<Lanes, kWidth>(a, rate_bytes, blocks);
+
+  for (size_t lane = 0; lane < (start.digest_size + 7) / 8; lane++) {
+    uint64 gathered[kWidth];
+    std::memcpy(gathered, &a[lane], sizeof(gathered));
+    const size_t bytes = std::min<size_t>(8, start.digest_size - 8 * lane);
+    for (size_t i = 0; i < kWidth; i++)
+      std::memcpy(outputs[i] + 8 * lane, &gathered[i], bytes);
+  }
+}
+
+#if defined(__x86_64__)
+typedef uint64 Lanes4 __attribute__((vector_size(32)));
+typedef uint64 Lanes8 __attribute__((vector_size(64)));
+
+__attribute__((target("avx2"))) void FinalAvx2(const BatchStart &start,
+                                               const uint8 *const *inputs,
+                                               size_t size,
+                                               uint8 *const *outputs) {
+  FinalLanes<Lanes4, 4>(start, inputs, size, outputs);
+}
+
+__attribute__((target("avx512f"))) void FinalAvx512(
+    const BatchStart &start, const uint8 *const *inputs, size_t size,
+    uint8 *const *outputs) {
+  FinalLanes<Lanes8, 8>(start, inputs, size, outputs);
+}
+#endif
+
+KeccakImplementation BestKeccakImplementation() {
+  static const KeccakImplementation best = [] {
+    for (KeccakImplementation implementation : {KECCAK_AVX512, KECCAK_AVX2})
+      if (KeccakImplementationSupported(implementation))
+        return implementation;
+    return KECCAK_SCALAR;
+  }();
+  return best;
+}
+
+}  // namespace
+
+bool KeccakImplementationSupported(KeccakImplementation implementation) {
+  switch (implementation) {
+    case KECCAK_SCALAR:
+      return true;
+#if defined(__x86_64__)
+    case KECCAK_AVX2:
+      return __builtin_cpu_supports("avx2");
+    case KECCAK_AVX512:
+      return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+      return false;
+  }
+}
+
+void Sha3Context::FinalBatch(const uint8 *const *inputs, size_t size,
+                             uint8 *const *outputs, size_t count,
+                             KeccakImplementation implementation) const {
+  MUST_NE(digest_size_, 0u, "Sha3Context::FinalBatch on SHAKE");
+  MUST(!squeezing_, "Sha3Context::FinalBatch after Final");
+  MUST(KeccakImplementationSupported(implementation));
+  const BatchStart start = {state_, rate_bytes_, position_, delimited_suffix_,
+                            digest_size_};
+  size_t i = 0;
+  switch (implementation) {
+#if defined(__x86_64__)
+    case KECCAK_AVX512:
+      for (; i + 8 <= count; i += 8)
+        FinalAvx512(start, inputs + i, size, outputs + i);
+      break;
+    case KECCAK_AVX2:
+      for (; i + 4 <= count; i += 4)
+        FinalAvx2(start, inputs + i, size, outputs + i);
+      break;
+#endif
+    default:
+      break;
+  }
+  for (; i < count; i++) {
+    Sha3Context context = *this;
+    context.Update(inputs[i], size);
+    context.Final(outputs[i]);
+  }
+}
+
+void Sha3Context::FinalBatch(const uint8 *const *inputs, size_t size,
+                             uint8 *const *outputs, size_t count) const {
+  FinalBatch(inputs, size, outputs, count, BestKeccakImplementation());
+}
+
+void SHA3_256Batch(const uint8 *const *inputs, size_t size,
+                   uint8 *const *outputs, size_t count,
+                   KeccakImplementation implementation) {
+  Sha3Context::Sha3_256().FinalBatch(inputs, size, outputs, count,
+                                     implementation);
+}
+
+void SHA3_256Batch(const uint8 *const *inputs, size_t size,
+                   uint8 *const *outputs, size_t count) {
+  Sha3Context::Sha3_256().FinalBatch(inputs, size, outputs, count);
+}
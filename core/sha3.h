@@ -1,14 +1,95 @@
 #pragma once
 
+#include <array>
+#include <boost/filesystem.hpp>
 #include <cstring>
 #include <vector>
 
+// The implementations of the batched Keccak permutation, chosen between at
+// runtime.  Exposed for tests and benchmarks.
+enum KeccakImplementation { KECCAK_SCALAR, KECCAK_AVX2, KECCAK_AVX512 };
+
+bool KeccakImplementationSupported(KeccakImplementation implementation);
+
+// An incremental SHA-3 or SHAKE computation, for input too large to hold in
+// memory at once.  Feed the input to Update in pieces of any size.  Then
+// either call Final once to get a SHA-3 digest, or call Squeeze as many
+// times as needed to read a SHAKE output stream in pieces.
+class Sha3Context {
+ public:
+  static Sha3Context Sha3_224() { return Sha3Context(1152, 0x06, 28); }
+  static Sha3Context Sha3_256() { return Sha3Context(1088, 0x06, 32); }
+  static Sha3Context Sha3_384() { return Sha3Context(832, 0x06, 48); }
+  static Sha3Context Sha3_512() { return Sha3Context(576, 0x06, 64); }
+  static Sha3Context Shake128() { return Sha3Context(1344, 0x1F, 0); }
+  static Sha3Context Shake256() { return Sha3Context(1088, 0x1F, 0); }
+
+  void Update(const void *input, size_t size);
+
+  template <typename Collection>
+  void Update(const Collection &input) {
+    static_assert(sizeof(typename Collection::value_type) == 1,
+                  "bad collection");
+    Update(input.data(), input.size());
+  }
+
+  // The size of the digest Final writes; zero for SHAKE.
+  size_t digest_size() const { return digest_size_; }
+
+  // Writes the digest_size() byte digest to output.  Only for SHA-3.
+  void Final(void *output);
+
+  // Finishes count copies of this context, copy i with the size bytes at
+  // inputs[i] appended, writing their digests to outputs[i].  The context
+  // itself is unchanged, so a common prefix is absorbed only once.  Copies
+  // are permuted four or eight at a time where the CPU allows.  Only for
+  // SHA-3.
+  void FinalBatch(const uint8 *const *inputs, size_t size,
+                  uint8 *const *outputs, size_t count) const;
+  void FinalBatch(const uint8 *const *inputs, size_t size,
+                  uint8 *const *outputs, size_t count,
+                  KeccakImplementation implementation) const;
+
+  // Writes the next size bytes of the output stream.  Only for SHAKE.  The
+  // first call ends the input.
+  void Squeeze(void *output, size_t size);
+
+ private:
+  Sha3Context(unsigned int rate, uint8 delimited_suffix, size_t digest_size);
+
+  void Pad();
+  void Extract(void *output, size_t size);
+
+  uint8 state_[200];
+  unsigned int rate_bytes_;
+  uint8 delimited_suffix_;
+  size_t digest_size_;
+  unsigned int position_ = 0;
+  bool squeezing_ = false;
+};
+
+// Feeds the contents of the file at path to context, reading it in large
+// blocks.
+void HashFile(const filesystem::path &path, Sha3Context &context);
+
+// Computes the SHA3-256 digests of count messages that are all size bytes
+// long.  inputs[i] points at message i and outputs[i] at 32 bytes for its
+// digest.  On CPUs with AVX2 or AVX-512 four or eight messages at a time go
+// through each permutation together, which is several times faster than
+// hashing them one by one.
+void SHA3_256Batch(const uint8 *const *inputs, size_t size,
+                   uint8 *const *outputs, size_t count);
+
+void SHA3_256Batch(const uint8 *const *inputs, size_t size,
+                   uint8 *const *outputs, size_t count,
+                   KeccakImplementation implementation);
+
 /**
   *  Function to compute SHA3-224 on the input message. The output length is
  * fixed to 28 bytes.
   */
 
-inline void SHAKE128(const void *input, unsigned int inputByteLen, void *output,
+inline void SHAKE128(const void *input, size_t inputByteLen, void *output,
                      int outputByteLen);
 
 template <typename Collection>
@@ -18,7 +99,7 @@ std::vector<uint8> SHAKE128(const Collection &input, int outputByteLen) {
   return output;
 }
 
-inline void SHAKE256(const void *input, unsigned int inputByteLen, void *output,
+inline void SHAKE256(const void *input, size_t inputByteLen, void *output,
                      int outputByteLen);
 
 template <typename Collection>
@@ -28,7 +109,7 @@ std::vector<uint8> SHAKE256(const Collection &input, int outputByteLen) {
   return output;
 }
 
-inline void SHA3_224(const void *input, unsigned int inputByteLen,
+inline void SHA3_224(const void *input, size_t inputByteLen,
                      void *output);
 
 template <typename Collection>
@@ -42,7 +123,7 @@ std::array<uint8, 224 / 8> SHA3_224(const Collection &input) {
   *  Function to compute SHA3-256 on the input message. The output length is
  * fixed to 32 bytes.
   */
-inline void SHA3_256(const void *input, unsigned int inputByteLen,
+inline void SHA3_256(const void *input, size_t inputByteLen,
                      void *output);
 
 template <typename Collection>
@@ -58,7 +139,7 @@ std::array<uint8, 256 / 8> SHA3_256(const Collection &input) {
  * fixed to 48 bytes.
   */
 
-inline void SHA3_384(const void *input, unsigned int inputByteLen,
+inline void SHA3_384(const void *input, size_t inputByteLen,
                      void *output);
 
 template <typename Collection>
@@ -72,7 +153,7 @@ std::array<uint8, 384 / 8> SHA3_384(const Collection &input) {
   *  Function to compute SHA3-512 on the input message. The output length is
  * fixed to 64 bytes.
   */
-inline void SHA3_512(const void *input, unsigned int inputByteLen,
+inline void SHA3_512(const void *input, size_t inputByteLen,
                      void *output);
 
 template <typename Collection>
@@ -122,7 +203,7 @@ inline void Keccak(unsigned int rate, unsigned int capacity,
 /**
   *  Function to compute SHAKE128 on the input message with any output length.
   */
-inline void SHAKE128(const void *input, unsigned int inputByteLen, void *output,
+inline void SHAKE128(const void *input, size_t inputByteLen, void *output,
                      int outputByteLen) {
   Keccak(1344, 256, (const uint8 *)input, inputByteLen, 0x1F, (uint8 *)output,
          outputByteLen);
@@ -131,108 +212,45 @@ inline void SHAKE128(const void *input, unsigned int inputByteLen, void *output,
 /**
   *  Function to compute SHAKE256 on the input message with any output length.
   */
-inline void SHAKE256(const void *input, unsigned int inputByteLen, void *output,
+inline void SHAKE256(const void *input, size_t inputByteLen, void *output,
                      int outputByteLen) {
   Keccak(1088, 512, (const uint8 *)input, inputByteLen, 0x1F, (uint8 *)output,
          outputByteLen);
 }
 
-inline void SHA3_224(const void *input, unsigned int inputByteLen,
+inline void SHA3_224(const void *input, size_t inputByteLen,
                      void *output) {
   Keccak(1152, 448, (const uint8 *)input, inputByteLen, 0x06, (uint8 *)output,
          28);
 }
 
-inline void SHA3_256(const void *input, unsigned int inputByteLen,
+inline void SHA3_256(const void *input, size_t inputByteLen,
                      void *output) {
   Keccak(1088, 512, (const uint8 *)input, inputByteLen, 0x06, (uint8 *)output,
          32);
 }
 
-inline void SHA3_384(const void *input, unsigned int inputByteLen,
+inline void SHA3_384(const void *input, size_t inputByteLen,
                      void *output) {
   Keccak(832, 768, (const uint8 *)input, inputByteLen, 0x06, (uint8 *)output,
          48);
 }
 
-inline void SHA3_512(const void *input, unsigned int inputByteLen,
+inline void SHA3_512(const void *input, size_t inputByteLen,
                      void *output) {
   Keccak(576, 1024, (const uint8 *)input, inputByteLen, 0x06, (uint8 *)output,
          64);
 }
 
-template <typename T, typename U>
-auto ROL64(T a, U offset) {
-  return (((uint64)a) << offset) ^ (((uint64)a) >> (64 - offset));
-}
-#define ixxx(x, y) ((x) + 5 * (y))
-
-#ifdef LITTLE_ENDIAN
-#define readLane(x, y) (((uint64 *)state)[ixxx(x, y)])
-#define writeLane(x, y, lane) (((uint64 *)state)[ixxx(x, y)]) = (lane)
-#define XORLane(x, y, lane) (((uint64 *)state)[ixxx(x, y)]) ^= (lane)
-#else
+#ifndef LITTLE_ENDIAN
 #error LITTLE ENDIAN REQUIRED
 #endif
 
-inline int LFSR86540(uint8 *LFSR) {
-  int result = ((*LFSR) & 0x01) != 0;
-  if (((*LFSR) & 0x80) != 0)
-    (*LFSR) = ((*LFSR) << 1) ^ 0x71;
-  else
-    (*LFSR) <<= 1;
-  return result;
-}
+// Applies the Keccak-f[1600] permutation to the 25 lanes of state.
+void KeccakF1600(uint64 *state);
 
 inline void KeccakF1600_StatePermute(void *state) {
-  unsigned int round, x, y, j, t;
-  uint8 LFSRstate = 0x01;
-
-  for (round = 0; round < 24; round++) {
-    {
-      uint64 C[5], D;
-
-      for (x = 0; x < 5; x++)
-        C[x] = readLane(x, 0) ^ readLane(x, 1) ^ readLane(x, 2) ^
-               readLane(x, 3) ^ readLane(x, 4);
-      for (x = 0; x < 5; x++) {
-        D = C[(x + 4) % 5] ^ ROL64(C[(x + 1) % 5], 1);
-        for (y = 0; y < 5; y++) XORLane(x, y, D);
-      }
-    }
-
-    {
-      uint64 current, temp;
-      x = 1;
-      y = 0;
-      current = readLane(x, y);
-      for (t = 0; t < 24; t++) {
-        unsigned int r = ((t + 1) * (t + 2) / 2) % 64;
-        unsigned int Y = (2 * x + 3 * y) % 5;
-        x = y;
-        y = Y;
-        temp = readLane(x, y);
-        writeLane(x, y, ROL64(current, r));
-        current = temp;
-      }
-    }
-
-    {
-      uint64 temp[5];
-      for (y = 0; y < 5; y++) {
-        for (x = 0; x < 5; x++) temp[x] = readLane(x, y);
-        for (x = 0; x < 5; x++)
-          writeLane(x, y, temp[x] ^ ((~temp[(x + 1) % 5]) & temp[(x + 2) % 5]));
-      }
-    }
-
-    {
-      for (j = 0; j < 7; j++) {
-        unsigned int bitPosition = (1 << j) - 1;  // 2^j-1
-        if (LFSR86540(&LFSRstate)) XORLane(0, 0, (uint64)1 << bitPosition);
-      }
-    }
-  }
+  KeccakF1600((uint64 *)state);
 }
 
 template <typename T, typename U>
@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "core/file_functions.h"
+#include "core/sha3.h"
+#include "main/noargs.h"
+
+constexpr size_t kBytes = 256 << 20;
+
+template <typename F>
+void Report(const string& name, F f) {
+  const float64 start = now_secs();
+  f();
+  const float64 elapsed = now_secs() - start;
+  std::cout << name << ": " << int64(kBytes / elapsed / 1e6) << " MB/sec"
+            << std::endl;
+}
+
+void Main() {
+  string input(kBytes, '\0');
+  for (size_t i = 0; i < kBytes; i++) input[i] = char(i * 2654435761u >> 24);
+  std::array<uint8, 32> one_shot, streamed, from_file;
+
+  Report("SHA3_256 one-shot", [&] { one_shot = SHA3_256(input); });
+  Report("Sha3Context 64KiB updates", [&] {
+    constexpr size_t kChunk = 64 << 10;
+    Sha3Context context = Sha3Context::Sha3_256();
+    for (size_t pos = 0; pos < kBytes; pos += kChunk)
+      context.Update(input.data() + pos, kChunk);
+    context.Final(streamed.data());
+  });
+
+  const filesystem::path path =
+      filesystem::temp_directory_path() / filesystem::unique_path();
+  SetFileContents(path, input);
+  Report("HashFile", [&] {
+    Sha3Context context = Sha3Context::Sha3_256();
+    HashFile(path, context);
+    context.Final(from_file.data());
+  });
+  filesystem::remove(path);
+
+  Report("Shake128 squeeze", [&] {
+    Sha3Context context = Sha3Context::Shake128();
+    context.Update(input.data(), 1024);
+    context.Squeeze(&input[0], kBytes);
+  });
+
+  // Proof-of-work sized messages, hashed one at a time and in batches.
+  constexpr size_t kMessageSize = 64;
+  constexpr size_t kMessages = kBytes / kMessageSize;
+  std::vector<const uint8*> inputs;
+  std::vector<uint8*> outputs;
+  std::vector<uint8> digests(kMessages * 32);
+  for (size_t i = 0; i < kMessages; i++) {
+    inputs.push_back((const uint8*)input.data() + i * kMessageSize);
+    outputs.push_back(digests.data() + i * 32);
+  }
+  Report("SHA3_256 64-byte messages", [&] {
+    for (size_t i = 0; i < kMessages; i++)
+      SHA3_256(inputs[i], kMessageSize, outputs[i]);
+  });
+  const std::vector<uint8> expected = digests;
+  for (auto implementation : {std::make_pair(KECCAK_SCALAR, "scalar"),
+                              std::make_pair(KECCAK_AVX2, "avx2"),
+                              std::make_pair(KECCAK_AVX512, "avx512")}) {
+    if (!KeccakImplementationSupported(implementation.first)) continue;
+    std::fill(digests.begin(), digests.end(), 0);
+    Report(string("SHA3_256Batch ") + implementation.second, [&] {
+      SHA3_256Batch(inputs.data(), kMessageSize, outputs.data(), kMessages,
+                    implementation.first);
+    });
+    if (digests != expected) {
+      std::cerr << "batch digests differ" << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+  }
+
+  if (one_shot != streamed || streamed != from_file) {
+    std::cerr << "digests differ" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+}
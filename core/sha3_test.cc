@@ -132,3 +132,120 @@ TEST(Sha3Test, Files) {
   ShaFileTest([](const ByteArray& input) { return SHA3_512(input); },
               source_root / "core/testdata/ShortMsgKAT_SHA3-512.txt");
 }
+
+TEST(Sha3Test, Context) {
+  string input;
+  for (int i = 0; i < 1000; i++) input += char(i * 7);
+
+  // Split the input at every point, and into small uneven pieces.
+  for (size_t split = 0; split <= input.size(); split += 37) {
+    Sha3Context context = Sha3Context::Sha3_256();
+    context.Update(input.data(), split);
+    context.Update(input.data() + split, input.size() - split);
+    std::array<uint8, 32> digest;
+    context.Final(digest.data());
+    EXPECT_EQ(SHA3_256(input), digest);
+  }
+  Sha3Context context = Sha3Context::Sha3_512();
+  for (size_t pos = 0; pos < input.size(); pos += 13)
+    context.Update(input.substr(pos, 13));
+  std::array<uint8, 64> digest;
+  context.Final(digest.data());
+  EXPECT_EQ(SHA3_512(input), digest);
+}
+
+TEST(Sha3Test, ShakeSqueeze) {
+  const string input = "The quick brown fox jumps over the lazy dog";
+  const std::vector<uint8> expected = SHAKE128(input, 1000);
+
+  Sha3Context context = Sha3Context::Shake128();
+  context.Update(input);
+  std::vector<uint8> output(1000);
+  size_t pos = 0;
+  for (size_t size : {1, 31, 168, 200, 600}) {
+    context.Squeeze(output.data() + pos, size);
+    pos += size;
+  }
+  EXPECT_EQ(expected, output);
+}
+
+TEST(Sha3Test, HashFile) {
+  const filesystem::path path =
+      filesystem::temp_directory_path() / filesystem::unique_path();
+  string contents;
+  for (int i = 0; i < 3'000'000; i++) contents += char(i % 251);
+  SetFileContents(path, contents);
+
+  Sha3Context context = Sha3Context::Sha3_256();
+  HashFile(path, context);
+  std::array<uint8, 32> digest;
+  context.Final(digest.data());
+  filesystem::remove(path);
+  EXPECT_EQ(SHA3_256(contents), digest);
+}
+
+TEST(Sha3Test, Batch) {
+  for (KeccakImplementation implementation :
+       {KECCAK_SCALAR, KECCAK_AVX2, KECCAK_AVX512}) {
+    if (!KeccakImplementationSupported(implementation)) continue;
+    for (size_t size : {0, 1, 135, 136, 137, 272, 1000}) {
+      for (size_t count : {1, 3, 4, 7, 8, 13, 17}) {
+        std::vector<std::vector<uint8>> inputs(count);
+        std::vector<std::array<uint8, 32>> outputs(count);
+        std::vector<const uint8*> input_pointers;
+        std::vector<uint8*> output_pointers;
+        for (size_t i = 0; i < count; i++) {
+          for (size_t j = 0; j < size; j++)
+            inputs[i].push_back(uint8(i * 31 + j * 7));
+          input_pointers.push_back(inputs[i].data());
+          output_pointers.push_back(outputs[i].data());
+        }
+        SHA3_256Batch(input_pointers.data(), size, output_pointers.data(),
+                      count, implementation);
+        for (size_t i = 0; i < count; i++)
+          EXPECT_EQ(SHA3_256(inputs[i]), outputs[i])
+              << implementation << " " << size << " " << count << " " << i;
+      }
+    }
+  }
+}
+
+TEST(Sha3Test, FinalBatch) {
+  string prefix;
+  for (int i = 0; i < 300; i++) prefix += char(i * 13);
+  for (KeccakImplementation implementation :
+       {KECCAK_SCALAR, KECCAK_AVX2, KECCAK_AVX512}) {
+    if (!KeccakImplementationSupported(implementation)) continue;
+    for (size_t prefix_size : {0, 5, 71, 72, 135, 136, 200}) {
+      Sha3Context sha3_256 = Sha3Context::Sha3_256();
+      sha3_256.Update(prefix.data(), prefix_size);
+      Sha3Context sha3_512 = Sha3Context::Sha3_512();
+      sha3_512.Update(prefix.data(), prefix_size);
+      for (size_t size : {0, 1, 64, 130, 136, 300}) {
+        constexpr size_t kCount = 9;
+        std::vector<string> messages(kCount);
+        std::array<std::array<uint8, 64>, kCount> digests;
+        const uint8* inputs[kCount];
+        uint8* outputs[kCount];
+        for (size_t i = 0; i < kCount; i++) {
+          for (size_t j = 0; j < size; j++) messages[i] += char(i + j * 5);
+          inputs[i] = (const uint8*)messages[i].data();
+          outputs[i] = digests[i].data();
+        }
+        sha3_256.FinalBatch(inputs, size, outputs, kCount, implementation);
+        for (size_t i = 0; i < kCount; i++) {
+          const auto expected =
+              SHA3_256(prefix.substr(0, prefix_size) + messages[i]);
+          EXPECT_TRUE(std::equal(expected.begin(), expected.end(),
+                                 digests[i].begin()))
+              << implementation << " " << prefix_size << " " << size;
+        }
+        sha3_512.FinalBatch(inputs, size, outputs, kCount, implementation);
+        for (size_t i = 0; i < kCount; i++)
+          EXPECT_EQ(SHA3_512(prefix.substr(0, prefix_size) + messages[i]),
+                    digests[i])
+              << implementation << " " << prefix_size << " " << size;
+      }
+    }
+  }
+}
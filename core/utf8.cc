@@ -1,5 +1,12 @@
 #include "core/utf8.h"
 
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 #include "core/must.h"
 
 enum Utf8DecodingState {
@@ -12,13 +19,30 @@ enum Utf8DecodingState {
   STATE_1_OF_3
 };
 
-bool IsValidUtf8(string_view utf8) {
+// The length of the run of ASCII that data starts with.
+static size_t AsciiPrefixLengthScalar(const char* data, size_t size) {
+  constexpr uint64 kHighBits = 0x8080'8080'8080'8080;
+  size_t i = 0;
+  for (; size - i >= 8; i += 8) {
+    uint64 word;
+    std::memcpy(&word, data + i, 8);
+    if (word & kHighBits) break;
+  }
+  while (i < size && uint8(data[i]) < 0b1000'0000) i++;
+  return i;
+}
+
+static bool IsValidUtf8Scalar(string_view utf8) {
   const char* cursor = utf8.data();
   const char* end = utf8.data() + utf8.size();
 
   Utf8DecodingState state = START;
 
   while (cursor != end) {
+    if (state == START) {
+      cursor += AsciiPrefixLengthScalar(cursor, end - cursor);
+      if (cursor == end) break;
+    }
     const uint8 code_unit = (uint8)*cursor;
     cursor++;
     switch (state) {
@@ -59,15 +83,218 @@ bool IsValidUtf8(string_view utf8) {
   return state == START;
 }
 
-string ConvertLatin1ToUtf8(string_view latin1) {
-  std::ostringstream oss;
-  for (char c : latin1) {
-    uint8 i = c;
-    if (i < 0b1000'0000)
-      oss << c;
-    else
-      oss << (char)((i >> 6) | 0b1100'0000)
-          << (char)((i & 0b0011'1111) | 0b1000'0000);
+#if defined(__x86_64__)
+
+// The vector validators check a block of bytes at a time against the rule
+// the state machine above implements: a byte must be a continuation byte
+// (10xxxxxx) exactly when a lead byte one to three bytes before it calls for
+// one, and no byte may be 11111xxx.  A lead byte 110xxxxx calls for a
+// continuation one byte on, 1110xxxx for two and 11110xxx for three.
+// Saturating subtraction finds the lead bytes: x - 0xBF is non-zero for
+// 110xxxxx and above, x - 0xDF for 1110xxxx and above, and so on.  The input
+// is followed by a block of zeros, so a sequence cut off at the end fails.
+
+__attribute__((target("sse4.1"), always_inline)) static inline void
+CheckBlockSse41(__m128i block, __m128i& previous, __m128i& error) {
+  const __m128i previous_1 = _mm_alignr_epi8(block, previous, 15);
+  const __m128i previous_2 = _mm_alignr_epi8(block, previous, 14);
+  const __m128i previous_3 = _mm_alignr_epi8(block, previous, 13);
+  const __m128i called_for = _mm_or_si128(
+      _mm_or_si128(_mm_subs_epu8(previous_1, _mm_set1_epi8(char(0xBF))),
+                   _mm_subs_epu8(previous_2, _mm_set1_epi8(char(0xDF)))),
+      _mm_subs_epu8(previous_3, _mm_set1_epi8(char(0xEF))));
+  const __m128i not_called_for =
+      _mm_cmpeq_epi8(called_for, _mm_setzero_si128());
+  const __m128i is_continuation =
+      _mm_cmplt_epi8(block, _mm_set1_epi8(char(0xC0)));
+  error =
+      _mm_or_si128(error, _mm_cmpeq_epi8(is_continuation, not_called_for));
+  error = _mm_or_si128(error,
+                       _mm_subs_epu8(block, _mm_set1_epi8(char(0xF7))));
+  previous = block;
+}
+
+__attribute__((target("sse4.1"))) static bool IsValidUtf8Sse41(
+    string_view utf8) {
+  const char* cursor = utf8.data();
+  const char* end = cursor + utf8.size();
+  __m128i previous = _mm_setzero_si128();
+  __m128i error = _mm_setzero_si128();
+
+  while (end - cursor >= 16) {
+    const __m128i block = _mm_loadu_si128((const __m128i*)cursor);
+    cursor += 16;
+    // ASCII following ASCII can't break the rule.
+    if (_mm_movemask_epi8(_mm_or_si128(block, previous)) == 0) continue;
+    CheckBlockSse41(block, previous, error);
+    if (!_mm_testz_si128(error, error)) return false;
+  }
+  alignas(16) char tail[16] = {};
+  std::memcpy(tail, cursor, end - cursor);
+  CheckBlockSse41(_mm_load_si128((const __m128i*)tail), previous, error);
+  if (end - cursor > 13) CheckBlockSse41(_mm_setzero_si128(), previous, error);
+  return _mm_testz_si128(error, error);
+}
+
+__attribute__((target("avx2"), always_inline)) static inline void
+CheckBlockAvx2(__m256i block, __m256i& previous, __m256i& error) {
+  // The high lane of previous and the low lane of block, so that alignr,
+  // which works within lanes, can shift bytes across the lane boundary.
+  const __m256i straddle = _mm256_permute2x128_si256(previous, block, 0x21);
+  const __m256i previous_1 = _mm256_alignr_epi8(block, straddle, 15);
+  const __m256i previous_2 = _mm256_alignr_epi8(block, straddle, 14);
+  const __m256i previous_3 = _mm256_alignr_epi8(block, straddle, 13);
+  const __m256i called_for = _mm256_or_si256(
+      _mm256_or_si256(
+          _mm256_subs_epu8(previous_1, _mm256_set1_epi8(char(0xBF))),
+          _mm256_subs_epu8(previous_2, _mm256_set1_epi8(char(0xDF)))),
+      _mm256_subs_epu8(previous_3, _mm256_set1_epi8(char(0xEF))));
+  const __m256i not_called_for =
+      _mm256_cmpeq_epi8(called_for, _mm256_setzero_si256());
+  const __m256i is_continuation =
+      _mm256_cmpgt_epi8(_mm256_set1_epi8(char(0xC0)), block);
+  error = _mm256_or_si256(
+      error, _mm256_cmpeq_epi8(is_continuation, not_called_for));
+  error = _mm256_or_si256(
+      error, _mm256_subs_epu8(block, _mm256_set1_epi8(char(0xF7))));
+  previous = block;
+}
+
+__attribute__((target("avx2"))) static bool IsValidUtf8Avx2(
+    string_view utf8) {
+  const char* cursor = utf8.data();
+  const char* end = cursor + utf8.size();
+  __m256i previous = _mm256_setzero_si256();
+  __m256i error = _mm256_setzero_si256();
+
+  while (end - cursor >= 32) {
+    const __m256i block = _mm256_loadu_si256((const __m256i*)cursor);
+    cursor += 32;
+    // ASCII following ASCII can't break the rule.
+    if (_mm256_movemask_epi8(_mm256_or_si256(block, previous)) == 0) continue;
+    CheckBlockAvx2(block, previous, error);
+    if (!_mm256_testz_si256(error, error)) return false;
+  }
+  alignas(32) char tail[32] = {};
+  std::memcpy(tail, cursor, end - cursor);
+  CheckBlockAvx2(_mm256_load_si256((const __m256i*)tail), previous, error);
+  if (end - cursor > 29)
+    CheckBlockAvx2(_mm256_setzero_si256(), previous, error);
+  return _mm256_testz_si256(error, error);
+}
+
+__attribute__((target("sse4.1"))) static size_t AsciiPrefixLengthSse41(
+    const char* data, size_t size) {
+  size_t i = 0;
+  for (; size - i >= 16; i += 16) {
+    const int mask =
+        _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(data + i)));
+    if (mask != 0) return i + __builtin_ctz(mask);
+  }
+  return i + AsciiPrefixLengthScalar(data + i, size - i);
+}
+
+__attribute__((target("avx2"))) static size_t AsciiPrefixLengthAvx2(
+    const char* data, size_t size) {
+  size_t i = 0;
+  for (; size - i >= 32; i += 32) {
+    const uint32 mask = _mm256_movemask_epi8(
+        _mm256_loadu_si256((const __m256i*)(data + i)));
+    if (mask != 0) return i + __builtin_ctz(mask);
   }
-  return oss.str();
+  return i + AsciiPrefixLengthScalar(data + i, size - i);
+}
+
+#endif  // defined(__x86_64__)
+
+// Copies runs of ASCII in bulk.  Where there is other text it converts a
+// short stretch at a time without branching, writing two bytes for every
+// character and keeping the second only if the character needs it.
+template <size_t (*AsciiPrefixLength)(const char*, size_t)>
+static string ConvertLatin1ToUtf8Impl(string_view latin1) {
+  constexpr size_t kStretch = 16;
+  size_t high_bytes = 0;
+  for (char c : latin1) high_bytes += uint8(c) >> 7;
+
+  string utf8(latin1.size() + high_bytes + 1, '\0');
+  const char* in = latin1.data();
+  const char* in_end = in + latin1.size();
+  char* out = &utf8[0];
+  while (in != in_end) {
+    const size_t ascii = AsciiPrefixLength(in, in_end - in);
+    std::memcpy(out, in, ascii);
+    in += ascii;
+    out += ascii;
+    const char* stretch_end = in + std::min<size_t>(kStretch, in_end - in);
+    while (in != stretch_end) {
+      const uint8 i = *in++;
+      const uint8 high = i >> 7;
+      out[0] = high ? (char)((i >> 6) | 0b1100'0000) : (char)i;
+      out[1] = (char)((i & 0b0011'1111) | 0b1000'0000);
+      out += 1 + high;
+    }
+  }
+  utf8.pop_back();
+  return utf8;
+}
+
+bool Utf8ImplementationSupported(Utf8Implementation implementation) {
+  switch (implementation) {
+    case UTF8_SCALAR:
+      return true;
+#if defined(__x86_64__)
+    case UTF8_SSE41:
+      return __builtin_cpu_supports("sse4.1");
+    case UTF8_AVX2:
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+static Utf8Implementation BestUtf8Implementation() {
+  static const Utf8Implementation best = [] {
+    for (Utf8Implementation implementation : {UTF8_AVX2, UTF8_SSE41})
+      if (Utf8ImplementationSupported(implementation)) return implementation;
+    return UTF8_SCALAR;
+  }();
+  return best;
+}
+
+bool IsValidUtf8(string_view utf8, Utf8Implementation implementation) {
+  MUST(Utf8ImplementationSupported(implementation));
+  switch (implementation) {
+#if defined(__x86_64__)
+    case UTF8_SSE41:
+      return IsValidUtf8Sse41(utf8);
+    case UTF8_AVX2:
+      return IsValidUtf8Avx2(utf8);
+#endif
+    default:
+      return IsValidUtf8Scalar(utf8);
+  }
+}
+
+string ConvertLatin1ToUtf8(string_view latin1,
+                           Utf8Implementation implementation) {
+  MUST(Utf8ImplementationSupported(implementation));
+  switch (implementation) {
+#if defined(__x86_64__)
+    case UTF8_SSE41:
+      return ConvertLatin1ToUtf8Impl<AsciiPrefixLengthSse41>(latin1);
+    case UTF8_AVX2:
+      return ConvertLatin1ToUtf8Impl<AsciiPrefixLengthAvx2>(latin1);
+#endif
+    default:
+      return ConvertLatin1ToUtf8Impl<AsciiPrefixLengthScalar>(latin1);
+  }
+}
+
+bool IsValidUtf8(string_view utf8) {
+  return IsValidUtf8(utf8, BestUtf8Implementation());
+}
+
+string ConvertLatin1ToUtf8(string_view latin1) {
+  return ConvertLatin1ToUtf8(latin1, BestUtf8Implementation());
 }
@@ -1,5 +1,19 @@
 #pragma once
 
+// Whether utf8 is a sequence of well-formed UTF-8 code unit sequences of one
+// to four bytes.  Overlong forms, surrogates and code points above U+10FFFF
+// are not rejected.
 bool IsValidUtf8(string_view utf8);
 
 string ConvertLatin1ToUtf8(string_view latin1);
+
+// The implementations the functions above choose between at runtime, by what
+// the CPU supports.  Exposed for tests and benchmarks.
+enum Utf8Implementation { UTF8_SCALAR, UTF8_SSE41, UTF8_AVX2 };
+
+bool Utf8ImplementationSupported(Utf8Implementation implementation);
+
+bool IsValidUtf8(string_view utf8, Utf8Implementation implementation);
+
+string ConvertLatin1ToUtf8(string_view latin1,
+                           Utf8Implementation implementation);
@@ -0,0 +1,50 @@
+#include <iostream>
+#include <vector>
+
+#include "core/utf8.h"
+#include "main/noargs.h"
+
+constexpr size_t kBytes = 64 << 20;
+constexpr int kRepetitions = 4;
+
+static string Repeat(const string& piece) {
+  string s;
+  s.reserve(kBytes + piece.size());
+  while (s.size() < kBytes) s += piece;
+  return s;
+}
+
+template <typename F>
+void Report(const string& name, size_t bytes, F f) {
+  const float64 start = now_secs();
+  for (int i = 0; i < kRepetitions; i++) f();
+  const float64 elapsed = now_secs() - start;
+  std::cout << name << ": " << int64(bytes * kRepetitions / elapsed / 1e6)
+            << " MB/sec" << std::endl;
+}
+
+void Main() {
+  const std::vector<std::pair<string, string>> inputs = {
+      {"ascii source", Repeat("  for (size_t i = 0; i < n; i++) f(i);\n")},
+      {"mixed subtitles", Repeat("- Où est la gare ? - C'est là-bas.\n")},
+      {"multibyte", Repeat("東京は日本の首都です。")},
+  };
+  const string latin1 = Repeat("Caf\xe9 cr\xe8me, s'il vous pla\xeet.\n");
+
+  const std::vector<std::pair<Utf8Implementation, string>> implementations =
+      {{UTF8_SCALAR, "scalar"}, {UTF8_SSE41, "sse4.1"}, {UTF8_AVX2, "avx2"}};
+  for (const auto& implementation : implementations) {
+    if (!Utf8ImplementationSupported(implementation.first)) continue;
+    for (const auto& input : inputs) {
+      Report("IsValidUtf8 " + implementation.second + " " + input.first,
+             input.second.size(), [&] {
+               if (!IsValidUtf8(input.second, implementation.first)) {
+                 std::cerr << "rejected valid input" << std::endl;
+                 std::exit(EXIT_FAILURE);
+               }
+             });
+    }
+    Report("ConvertLatin1ToUtf8 " + implementation.second, latin1.size(),
+           [&] { ConvertLatin1ToUtf8(latin1, implementation.first); });
+  }
+}
@@ -1,5 +1,7 @@
 #include "core/utf8.h"
 
+#include <random>
+
 #include "core/must.h"
 #include "gtest/gtest.h"
 
@@ -77,3 +79,47 @@ TEST(Utf8Test, ConvertLatin1ToUtf8) {
   EXPECT_EQ(ConvertLatin1ToUtf8(str(0b1100'1010)),
             str(0b1100'0011, 0b1000'1010));
 }
+
+// Strings built mostly from the pieces of well-formed sequences, so that
+// they are valid often and go wrong in every way when they are not.
+static string RandomUtf8ish(std::mt19937& rng) {
+  static const std::vector<string> pieces = {
+      "a", "hello world, ", str(0xC3, 0xA9), str(0xE2, 0x82, 0xAC),
+      str(0xF0, 0x9F, 0x98, 0x80), str(0x80), str(0xC3), str(0xE2, 0x82),
+      str(0xF8), str(0xFF), string(40, 'x')};
+  string s;
+  const size_t n = rng() % 40;
+  for (size_t i = 0; i < n; i++) {
+    s += pieces[rng() % pieces.size()];
+  }
+  return s;
+}
+
+TEST(Utf8Test, ImplementationsAgree) {
+  std::mt19937 rng(42);
+  for (int i = 0; i < 100000; i++) {
+    const string s = RandomUtf8ish(rng);
+    const bool valid = IsValidUtf8(s, UTF8_SCALAR);
+    const string converted = ConvertLatin1ToUtf8(s, UTF8_SCALAR);
+    for (Utf8Implementation implementation : {UTF8_SSE41, UTF8_AVX2}) {
+      if (!Utf8ImplementationSupported(implementation)) continue;
+      EXPECT_EQ(valid, IsValidUtf8(s, implementation)) << implementation;
+      EXPECT_EQ(converted, ConvertLatin1ToUtf8(s, implementation));
+    }
+  }
+}
+
+TEST(Utf8Test, TruncatedAtBlockEnds) {
+  for (Utf8Implementation implementation :
+       {UTF8_SCALAR, UTF8_SSE41, UTF8_AVX2}) {
+    if (!Utf8ImplementationSupported(implementation)) continue;
+    for (size_t prefix = 0; prefix < 70; prefix++) {
+      const string ascii(prefix, 'a');
+      const string four = str(0xF0, 0x9F, 0x98, 0x80);
+      for (size_t cut = 1; cut < 4; cut++)
+        EXPECT_FALSE(IsValidUtf8(ascii + four.substr(0, cut), implementation))
+            << implementation << " " << prefix << " " << cut;
+      EXPECT_TRUE(IsValidUtf8(ascii + four, implementation));
+    }
+  }
+}
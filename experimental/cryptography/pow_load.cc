@@ -0,0 +1,65 @@
+#include <netinet/tcp.h>
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "core/must.h"
+#include "experimental/cryptography/pow.pb.h"
+#include "main/args.h"
+#include "network/socket.h"
+
+// Simulates many workers against a local pow_server.  Each thread drives its
+// share of the workers' persistent connections in lockstep: every worker
+// asks for a lease, reporting a trivial proof as a real worker reports its
+// finds, and then every worker reads its lease.
+void Main(const std::vector<string>& args) {
+  if (args.size() != 3)
+    FAIL("usage: pow_load <workers> <threads> <seconds>");
+  const size_t nworkers = std::stoul(args[0]);
+  const size_t nthreads = std::stoul(args[1]);
+  const float64 seconds = std::stod(args[2]);
+  MUST_GT(nthreads, 0u);
+
+  std::atomic<int64> leases(0);
+  std::atomic<int64> rounds(0);
+  std::vector<std::thread> threads;
+  const float64 start = now_secs();
+  for (size_t t = 0; t < nthreads; t++) {
+    threads.emplace_back([&, t] {
+      std::vector<network::Socket> socks;
+      for (size_t i = t; i < nworkers; i += nthreads) {
+        socks.emplace_back();
+        socks.back().Connect("127.0.0.1", "35358");
+        socks.back().SetOptInt(IPPROTO_TCP, TCP_NODELAY, 1);
+      }
+
+      LeaseRequest request;
+      request.set_count(1);
+      ProofOfWorkProto* proof_of_work = request.add_proof_of_work();
+      proof_of_work->set_subject("Hello, Worldz!");
+      proof_of_work->set_suffix("");
+      proof_of_work->set_len(0);
+      WorkLease lease;
+      int64 thread_leases = 0;
+      int64 thread_rounds = 0;
+      while (now_secs() - start < seconds) {
+        for (network::Socket& sock : socks) sock.SendMessage(request);
+        for (network::Socket& sock : socks)
+          MUST(sock.ReceiveMessage(lease), "server closed the connection");
+        thread_leases += socks.size();
+        thread_rounds++;
+      }
+      leases += thread_leases;
+      rounds += thread_rounds;
+    });
+  }
+  for (std::thread& t : threads) t.join();
+
+  const float64 elapsed = now_secs() - start;
+  std::cout << nworkers << " workers: " << int64(leases / elapsed)
+            << " leases/sec, "
+            << (rounds ? elapsed * nthreads / rounds * 1e6 : 0)
+            << " usecs per round trip of every worker" << std::endl;
+}
@@ -1,65 +1,121 @@
+#include <algorithm>
 #include <atomic>
-#include <list>
+#include <iostream>
+#include <thread>
+#include <vector>
 
 #include "core/hex.h"
-#include "core/must.h"
-#include "experimental/cryptography/proof_of_work.h"
 #include "experimental/cryptography/pow.pb.h"
+#include "experimental/cryptography/proof_of_work.h"
 #include "main/noargs.h"
+#include "network/async_socket.h"
+#include "network/event_loop.h"
 #include "network/socket.h"
 
 const std::string subject = "Hello, Worldz!";
 const int width = 3;
+constexpr int32 kMaxLeaseSize = 1024;
 
-std::atomic_int next_init_suffix(0);
+// Far more than a LeaseRequest needs, as a worker sends only the few proofs
+// found in one lease.  A larger or unparseable request drops the connection.
+constexpr uint64 kMaxRequestSize = 16 << 10;
 
-Mutex best_len_mu;
+// Shared by all event loops and only ever updated atomically.
+std::atomic<int64> next_init_suffix(0);
+std::atomic<int64> leases(0);
 std::atomic_int best_len(1);
 
-void Handler(network::Socket sock) {
-  WorkRequest request;
-  request.set_subject(subject);
-  request.set_len(best_len + 1);
-  int id = next_init_suffix++;
-  if (0 == (id & (id - 1))) {
-    std::cout << "request " << id << std::endl;
+Mutex cout_mu;
+
+// Raises best_len to len, returning whether it was lower.
+bool RaiseBestLen(int len) {
+  int current = best_len;
+  while (len > current) {
+    if (best_len.compare_exchange_weak(current, len)) return true;
   }
-  request.set_init_suffix(std::to_string(id));
-  request.set_width(width);
-  sock.SendMessage(request);
-  sock.Flush();
-  WorkResponse response;
-  MUST(sock.ReceiveMessage(response));
-  if (response.has_proof_of_work()) {
-    LockGuard l(best_len_mu);
-    const ProofOfWorkProto& proof_of_work_proto = response.proof_of_work();
+  return false;
+}
+
+void HandleLeaseRequest(const LeaseRequest& request, WorkLease& lease) {
+  for (const ProofOfWorkProto& proof_of_work_proto :
+       request.proof_of_work()) {
     ProofOfWork proof_of_work;
     proof_of_work.subject = proof_of_work_proto.subject();
     proof_of_work.suffix = proof_of_work_proto.suffix();
     proof_of_work.len = proof_of_work_proto.len();
-    if (Verify(proof_of_work)) {
-      if (proof_of_work.len > best_len) {
-        best_len = proof_of_work.len;
-        std::cout << "proof of len " << best_len
-                  << " found: " << ByteArrayToHexString(proof_of_work.suffix)
-                  << std::endl;
-      }
-    } else {
+    if (proof_of_work.subject != subject || !Verify(proof_of_work)) {
+      LockGuard l(cout_mu);
       std::cerr << "unverified proof received" << std::endl;
+    } else if (RaiseBestLen(proof_of_work.len)) {
+      LockGuard l(cout_mu);
+      std::cout << "proof of len " << proof_of_work.len
+                << " found: " << ByteArrayToHexString(proof_of_work.suffix)
+                << std::endl;
     }
   }
-  MUST(!sock.ReceiveInteger());
-  sock.Shutdown(SHUT_WR);
+
+  const int32 count = std::max(1, std::min(request.count(), kMaxLeaseSize));
+  lease.set_subject(subject);
+  lease.set_len(best_len + 1);
+  lease.set_width(width);
+  lease.set_first_id(next_init_suffix.fetch_add(count));
+  lease.set_count(count);
+
+  const int64 id = leases++;
+  if (0 == (id & (id - 1))) {
+    LockGuard l(cout_mu);
+    std::cout << "lease " << id << std::endl;
+  }
 }
 
-void Main() {
-  network::Socket server;
-  server.Bind(35358);
-  server.Listen(5);
+// A worker's connection, which deletes itself once the worker has gone or
+// has sent a bad request.
+class Connection {
+ public:
+  Connection(network::EventLoop& loop, network::Socket sock)
+      : sock_(loop, std::move(sock), kMaxRequestSize) {
+    Next();
+  }
 
-  while (true) {
-    network::Socket sock = Accept(server);
-    std::thread t(Handler, std::move(sock));
-    t.detach();
+ private:
+  void Next() {
+    sock_.ReceiveMessage(request_, [this](bool received) {
+      if (!received) {
+        delete this;
+        return;
+      }
+      WorkLease lease;
+      HandleLeaseRequest(request_, lease);
+      sock_.SendMessage(lease);
+      Next();
+    });
   }
+
+  network::AsyncSocket sock_;
+  LeaseRequest request_;
+};
+
+// Serves connections until the process exits.  Every thread has its own
+// listening socket on the port, and SO_REUSEPORT spreads incoming
+// connections among them.
+void Serve() {
+  network::Socket listener;
+  listener.SetOptInt(SOL_SOCKET, SO_REUSEADDR, 1);
+  listener.SetOptInt(SOL_SOCKET, SO_REUSEPORT, 1);
+  listener.Bind(35358);
+  listener.Listen(SOMAXCONN);
+
+  network::EventLoop loop;
+  network::AsyncListener accepter(
+      loop, std::move(listener), [&loop](network::Socket sock) {
+        new Connection(loop, std::move(sock));
+      });
+  loop.Run();
+}
+
+void Main() {
+  const size_t nthreads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < nthreads; i++) threads.emplace_back(Serve);
+  for (std::thread& t : threads) t.join();
 }
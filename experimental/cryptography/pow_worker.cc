@@ -1,28 +1,49 @@
 #include "experimental/cryptography/proof_of_work.h"
 
+#include <iostream>
+
 #include "core/must.h"
 #include "experimental/cryptography/pow.pb.h"
 #include "network/socket.h"
 
+constexpr int32 kLeaseSize = 16;
+
 void Main() {
+  network::Socket sock;
+  sock.Connect("66.85.186.238", "35358");
+  LeaseRequest request;
   while (true) {
-    network::Socket sock;
-    sock.Connect("66.85.186.238", "35358");
-    WorkRequest request;
-    MUST(sock.ReceiveMessage(request));
-    optional<ProofOfWork> proof_of_work =
-        Work(request.subject(), request.len(), request.init_suffix(),
-             request.width());
-    WorkResponse response;
-    if (proof_of_work) {
-      ProofOfWorkProto* proof_of_work_proto = response.mutable_proof_of_work();
-      proof_of_work_proto->set_subject(proof_of_work->subject);
-      proof_of_work_proto->set_suffix(proof_of_work->suffix);
-      proof_of_work_proto->set_len(proof_of_work->len);
-    }
-    sock.SendMessage(response);
+    request.set_count(kLeaseSize);
+    sock.SendMessage(request);
     sock.Flush();
-    sock.Shutdown(SHUT_WR);
-    MUST(!sock.ReceiveInteger());
+    request.Clear();
+
+    WorkLease lease;
+    MUST(sock.ReceiveMessage(lease), "server closed the connection");
+    int len = lease.len();
+    WorkOptions options;
+    WorkStats stats;
+    options.stats = &stats;
+    int64 hashes = 0;
+    const float64 start = now_secs();
+    for (int64 id = lease.first_id(); id < lease.first_id() + lease.count();
+         id++) {
+      optional<ProofOfWork> proof_of_work = Work(
+          lease.subject(), len, std::to_string(id), lease.width(), options);
+      hashes += stats.hashes;
+      if (proof_of_work) {
+        ProofOfWorkProto* proof_of_work_proto = request.add_proof_of_work();
+        proof_of_work_proto->set_subject(proof_of_work->subject);
+        proof_of_work_proto->set_suffix(proof_of_work->suffix);
+        proof_of_work_proto->set_len(proof_of_work->len);
+        // Only a longer proof is worth finding in the rest of the lease.
+        len = proof_of_work->len + 1;
+      }
+    }
+    const float64 elapsed = now_secs() - start;
+    std::cout << hashes << " hashes in " << elapsed << " secs on "
+              << stats.threads << " threads: "
+              << int64(hashes / elapsed / stats.threads)
+              << " hashes/sec/thread" << std::endl;
   }
 }
@@ -0,0 +1,120 @@
+#include "experimental/cryptography/proof_of_work.h"
+
+#include <algorithm>
+#include <exception>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "core/must.h"
+
+namespace {
+
+constexpr size_t kBatchSize = 8;
+constexpr uint64 kChunkSize = 4096;
+constexpr uint64 kNotFound = std::numeric_limits<uint64>::max();
+
+bool HasLeadingZeros(const uint8* digest, int len) {
+  for (int i = 0; i < len; i++)
+    if (digest[i] != 0) return false;
+  return true;
+}
+
+void LowerTo(std::atomic<uint64>& value, uint64 bound) {
+  uint64 current = value;
+  while (bound < current && !value.compare_exchange_weak(current, bound)) {
+  }
+}
+
+}  // namespace
+
+optional<ProofOfWork> Work(const string& subject, int len,
+                           const string& init_suffix, int width,
+                           const WorkOptions& options) {
+  MUST_GE(width, 0);
+  MUST_LE(len, 32);
+  const size_t nthreads =
+      options.threads != 0
+          ? options.threads
+          : std::max<size_t>(1, std::thread::hardware_concurrency());
+  const uint64 counters =
+      width < 8 ? uint64(1) << (8 * width) : kNotFound;
+  const size_t counter_bytes = std::min(width, 8);
+
+  Sha3Context prefix = Sha3Context::Sha3_256();
+  prefix.Update(subject);
+  prefix.Update(init_suffix);
+
+  std::atomic<uint64> next_chunk(0);
+  std::atomic<uint64> found(kNotFound);
+  std::atomic<int64> hashes(0);
+  auto cancelled = [&] {
+    return options.best_len != nullptr && *options.best_len >= len;
+  };
+
+  auto search = [&] {
+    std::vector<uint8> suffixes(kBatchSize * width, 0);
+    const uint8* inputs[kBatchSize];
+    uint8* outputs[kBatchSize];
+    uint8 digests[kBatchSize][32];
+    for (size_t i = 0; i < kBatchSize; i++) {
+      inputs[i] = suffixes.data() + i * width;
+      outputs[i] = digests[i];
+    }
+    int64 hashed = 0;
+    while (!cancelled()) {
+      const uint64 begin = next_chunk.fetch_add(kChunkSize);
+      if (begin >= counters || begin >= found) break;
+      const uint64 end = std::min(begin + kChunkSize, counters);
+      for (uint64 counter = begin; counter < end && counter < found;
+           counter += kBatchSize) {
+        const size_t count = std::min<uint64>(kBatchSize, end - counter);
+        for (size_t i = 0; i < count; i++) {
+          const uint64 candidate = counter + i;
+          for (size_t j = 0; j < counter_bytes; j++)
+            suffixes[i * width + j] = uint8(candidate >> (8 * j));
+        }
+        prefix.FinalBatch(inputs, width, outputs, count);
+        hashed += count;
+        for (size_t i = 0; i < count; i++) {
+          if (HasLeadingZeros(digests[i], len)) {
+            LowerTo(found, counter + i);
+            break;
+          }
+        }
+      }
+    }
+    hashes += hashed;
+  };
+
+  const float64 start = now_secs();
+  std::vector<std::thread> threads;
+  std::vector<std::exception_ptr> errors(nthreads);
+  for (size_t i = 0; i < nthreads; i++) {
+    threads.emplace_back([&](size_t index) {
+      try {
+        search();
+      } catch (...) {
+        errors[index] = std::current_exception();
+      }
+    }, i);
+  }
+  for (std::thread& t : threads) t.join();
+  for (const std::exception_ptr& error : errors)
+    if (error) std::rethrow_exception(error);
+
+  if (options.stats) {
+    options.stats->hashes = hashes;
+    options.stats->seconds = now_secs() - start;
+    options.stats->threads = nthreads;
+  }
+
+  if (found == kNotFound) return nullopt;
+  ProofOfWork proof_of_work;
+  proof_of_work.subject = subject;
+  proof_of_work.suffix = init_suffix + string(width, '\0');
+  for (size_t j = 0; j < counter_bytes; j++)
+    proof_of_work.suffix[init_suffix.size() + j] = char(found >> (8 * j));
+  proof_of_work.len = len;
+  return proof_of_work;
+}
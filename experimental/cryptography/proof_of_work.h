@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+
 #include "core/sha3.h"
 
 struct ProofOfWork {
@@ -17,37 +19,38 @@ inline bool Verify(const ProofOfWork& proof_of_work) {
   return true;
 }
 
-inline optional<ProofOfWork> Work(const string& subject, int len,
-                                  const string& init_suffix, int width) {
-  string concatenated = subject + init_suffix + string(width, '\0');
-  uint8* const input = (uint8*)concatenated.data();
-  const size_t input_len = concatenated.size();
-
-  uint8* const suffix = input + subject.size() + init_suffix.size();
-
-  uint8 md[32];
-  while (true) {
-    SHA3_256(concatenated.data(), input_len, md);
-    bool success = true;
-    for (int i = 0; i < len; i++) {
-      if (md[i] != 0) {
-        success = false;
-        break;
-      }
-    }
-    if (success) {
-      ProofOfWork proof_of_work;
-      proof_of_work.subject = subject;
-      proof_of_work.suffix = concatenated.substr(subject.size());
-      proof_of_work.len = len;
-      return proof_of_work;
-    }
-    uint8 carry = 1;
-    for (int i = 0; i < width; i++) {
-      suffix[i] += carry;
-      carry = (carry && suffix[i] == 0x00);
-      if (!carry) break;
-    }
-    if (carry) return nullopt;
+// What a Work search did, for reporting throughput.
+struct WorkStats {
+  int64 hashes = 0;
+  float64 seconds = 0;
+  size_t threads = 0;
+
+  float64 HashesPerSecondPerThread() const {
+    return seconds > 0 ? hashes / seconds / threads : 0;
   }
-}
+};
+
+struct WorkOptions {
+  // The number of threads to search with; zero for one per core.
+  size_t threads = 0;
+
+  // If set, the search gives up once *best_len reaches len, that is once a
+  // proof at least as long has been found elsewhere.
+  const std::atomic_int* best_len = nullptr;
+
+  // If set, receives the statistics of the search.
+  WorkStats* stats = nullptr;
+};
+
+// Tries suffixes init_suffix + c for successive little-endian width byte
+// counters c, starting from zero, and returns the first that gives a proof of
+// work, or nullopt if every counter fails or the search is cancelled.
+//
+// The counter space is handed out to the threads in chunks.  subject +
+// init_suffix is absorbed once, and each thread hashes its candidates in
+// batches with Sha3Context::FinalBatch, so only the blocks holding the
+// counter are permuted per candidate.  Counters past 2^64 - 1 are never
+// tried.
+optional<ProofOfWork> Work(const string& subject, int len,
+                           const string& init_suffix, int width,
+                           const WorkOptions& options = WorkOptions());
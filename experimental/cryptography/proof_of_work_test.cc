@@ -9,3 +9,30 @@ TEST(ProofOfWorkTest, Simple) {
   ASSERT_FALSE(Work("", 2, "", 0));
   ASSERT_FALSE(Work("foo", 32, "bar", 2));
 }
+
+TEST(ProofOfWorkTest, Threads) {
+  for (size_t threads : {1, 2, 5}) {
+    WorkOptions options;
+    options.threads = threads;
+    WorkStats stats;
+    options.stats = &stats;
+    auto proof_of_work = Work("Hello, World!", 2, "x", 3, options);
+    ASSERT_TRUE(proof_of_work);
+    EXPECT_TRUE(Verify(*proof_of_work));
+    // Every thread count finds the same, first, suffix.
+    EXPECT_EQ(Work("Hello, World!", 2, "x", 3, WorkOptions{1})->suffix,
+              proof_of_work->suffix);
+    EXPECT_EQ(threads, stats.threads);
+    EXPECT_GT(stats.hashes, 0);
+  }
+}
+
+TEST(ProofOfWorkTest, Cancel) {
+  const std::atomic_int best_len(4);
+  WorkOptions options;
+  options.best_len = &best_len;
+  WorkStats stats;
+  options.stats = &stats;
+  EXPECT_FALSE(Work("Hello, World!", 3, "", 4, options));
+  EXPECT_EQ(0, stats.hashes);
+}
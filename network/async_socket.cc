@@ -0,0 +1,270 @@
+#include "network/async_socket.h"
+
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "core/bigint.h"
+#include "core/must.h"
+
+namespace network {
+
+constexpr size_t kInitialBufferSize = 16 << 10;
+
+// The longest size prefix read.  Enough for the largest message protobuf
+// parses, INT_MAX bytes, and too short for unpack_uint64 to overflow.
+constexpr size_t kMaxSizePrefix = 5;
+
+AsyncSocket::AsyncSocket(EventLoop& loop, Socket sock,
+                         uint64 max_message_size)
+    : loop_(loop),
+      sock_(std::move(sock)),
+      alive_(std::make_shared<bool>(true)),
+      max_message_size_(
+          std::min(max_message_size, uint64(std::numeric_limits<int>::max()))),
+      in_(kInitialBufferSize) {
+  sock_.SetNonBlocking(true);
+  // Output is already gathered into one send per event, so Nagle's
+  // algorithm would only add latency.
+  sock_.SetOptInt(IPPROTO_TCP, TCP_NODELAY, 1);
+  id_ = loop_.Add(sock_.fd(), 0, [this](uint32 events) {
+    HandleEvents(events);
+  });
+}
+
+AsyncSocket::~AsyncSocket() {
+  *alive_ = false;
+  if (watching_) loop_.Remove(id_);
+}
+
+void AsyncSocket::ReceiveMessage(protobuf::Message& message,
+                                 std::function<void(bool)> done) {
+  MUST(!receive_done_, "AsyncSocket::ReceiveMessage already pending");
+  receive_message_ = &message;
+  receive_done_ = std::move(done);
+  if (!in_handler_) {
+    if (Deliverable()) ScheduleDelivery();
+    Update();
+  }
+}
+
+void AsyncSocket::SendMessage(const protobuf::Message& message,
+                              std::function<void()> done) {
+  if (broken_) return;
+  const size_t message_size = message.ByteSizeLong();
+  const size_t pos = out_.size();
+  out_.resize(pos + kMaxPackedUint64Size + message_size);
+  char* end = &out_[pos];
+  end += pack_uint64(message_size, end);
+  end = (char*)message.SerializeWithCachedSizesToArray((uint8*)end);
+  out_.resize(end - out_.data());
+  queued_ += out_.size() - pos;
+  if (done) send_done_.emplace_back(queued_, std::move(done));
+  // Inside a handler the output goes out in one send once the callbacks
+  // have run.
+  if (!in_handler_) {
+    WriteOutput();
+    if (Deliverable()) ScheduleDelivery();
+    Update();
+  }
+}
+
+void AsyncSocket::ShutdownWrite() {
+  shutdown_pending_ = true;
+  if (!in_handler_) {
+    WriteOutput();
+    Update();
+  }
+}
+
+void AsyncSocket::HandleEvents(uint32 events) {
+  std::shared_ptr<bool> alive = alive_;
+  in_handler_ = true;
+  if (events & (EPOLLERR | EPOLLHUP)) {
+    // The connection is gone both ways; read whatever arrived before.
+    broken_ = true;
+    ReadInput();
+    eof_ = true;
+  } else {
+    if (events & EPOLLIN) ReadInput();
+    if (events & EPOLLOUT) WriteOutput();
+  }
+  if (!Deliver()) return;
+  WriteOutput();
+  in_handler_ = false;
+  Update();
+}
+
+void AsyncSocket::ReadInput() {
+  while (!eof_) {
+    if (in_end_ == in_.size()) {
+      if (in_pos_ != 0) {
+        std::memmove(in_.data(), in_.data() + in_pos_, in_end_ - in_pos_);
+        in_end_ -= in_pos_;
+        in_pos_ = 0;
+      } else if (in_.size() >= kMaxSizePrefix + max_message_size_) {
+        // Holds a whole message, or enough to tell that it is too large.
+        return;
+      } else {
+        in_.resize(std::min<uint64>(in_.size() * 2,
+                                    kMaxSizePrefix + max_message_size_));
+      }
+    }
+    const ssize_t received =
+        recv(sock_.fd(), in_.data() + in_end_, in_.size() - in_end_, 0);
+    if (received == -1) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+      if (errno == ECONNRESET) {
+        broken_ = eof_ = true;
+        return;
+      }
+      THROW_ERRNO("recv");
+    }
+    if (received == 0) eof_ = true;
+    in_end_ += received;
+    // Read no further than the pending receive needs, or than a buffer's
+    // worth while nobody is waiting, so that a fast sender of small messages
+    // can't make the buffer grow or hold up the loop.
+    uint64 message_size;
+    if (receive_done_ ? NextMessage(message_size) != nullptr
+                      : in_end_ == in_.size())
+      return;
+  }
+}
+
+void AsyncSocket::WriteOutput() {
+  while (!broken_ && out_pos_ < out_.size()) {
+    const ssize_t sent = send(sock_.fd(), out_.data() + out_pos_,
+                              out_.size() - out_pos_, MSG_NOSIGNAL);
+    if (sent == -1) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+      if (errno == EPIPE || errno == ECONNRESET) {
+        broken_ = eof_ = true;
+        break;
+      }
+      THROW_ERRNO("send");
+    }
+    out_pos_ += sent;
+    sent_ += sent;
+  }
+  if (broken_) {
+    send_done_.clear();
+    shutdown_pending_ = false;
+  }
+  out_.clear();
+  out_pos_ = 0;
+  if (shutdown_pending_) {
+    shutdown_pending_ = false;
+    sock_.Shutdown(SHUT_WR);
+  }
+}
+
+bool AsyncSocket::Deliverable() {
+  if (!send_done_.empty() && send_done_.front().first <= sent_) return true;
+  if (!receive_done_) return false;
+  uint64 message_size;
+  return NextMessage(message_size) || eof_;
+}
+
+const char* AsyncSocket::NextMessage(uint64& message_size) {
+  const char* begin = in_.data() + in_pos_;
+  const char* end = in_.data() + in_end_;
+  const size_t prefix_size = std::min(size_t(end - begin), kMaxSizePrefix);
+  const char* message = unpack_uint64(begin, begin + prefix_size, message_size);
+  if (!message && prefix_size < kMaxSizePrefix) return nullptr;
+  if (!message || message_size > max_message_size_) {
+    EndBadStream();
+    return nullptr;
+  }
+  return uint64(end - message) >= message_size ? message : nullptr;
+}
+
+// Drops the input and reads no more, as if the peer had closed.
+void AsyncSocket::EndBadStream() {
+  eof_ = true;
+  in_pos_ = in_end_ = 0;
+}
+
+bool AsyncSocket::Deliver() {
+  std::shared_ptr<bool> alive = alive_;
+  while (Deliverable()) {
+    if (!send_done_.empty() && send_done_.front().first <= sent_) {
+      std::function<void()> done = std::move(send_done_.front().second);
+      send_done_.pop_front();
+      done();
+      if (!*alive) return false;
+      continue;
+    }
+
+    std::function<void(bool)> done = std::move(receive_done_);
+    receive_done_ = nullptr;
+    uint64 message_size;
+    const char* message = NextMessage(message_size);
+    if (message &&
+        receive_message_->ParseFromArray(message, int(message_size))) {
+      in_pos_ = message + message_size - in_.data();
+      if (in_pos_ == in_end_) in_pos_ = in_end_ = 0;
+      done(true);
+    } else {
+      if (message) EndBadStream();
+      done(false);
+    }
+    if (!*alive) return false;
+  }
+  return true;
+}
+
+// Watches for input only while a receive is waiting for it, and for room to
+// send only while output is backed up.  A broken connection is not watched
+// at all, since epoll would report it again and again.
+void AsyncSocket::Update() {
+  if (!watching_) return;
+  if (broken_ && eof_) {
+    loop_.Remove(id_);
+    watching_ = false;
+    return;
+  }
+  uint32 events = 0;
+  if (receive_done_ && !eof_) events |= EPOLLIN;
+  if (out_pos_ < out_.size()) events |= EPOLLOUT;
+  if (events != events_) {
+    loop_.Modify(id_, events);
+    events_ = events;
+  }
+}
+
+void AsyncSocket::ScheduleDelivery() {
+  if (delivery_scheduled_) return;
+  delivery_scheduled_ = true;
+  std::shared_ptr<bool> alive = alive_;
+  loop_.Post([this, alive] {
+    if (!*alive) return;
+    delivery_scheduled_ = false;
+    in_handler_ = true;
+    if (!Deliver()) return;
+    WriteOutput();
+    in_handler_ = false;
+    Update();
+  });
+}
+
+AsyncListener::AsyncListener(EventLoop& loop, Socket listener,
+                             std::function<void(Socket)> on_accept)
+    : loop_(loop),
+      listener_(std::move(listener)),
+      on_accept_(std::move(on_accept)) {
+  listener_.SetNonBlocking(true);
+  id_ = loop_.Add(listener_.fd(), EPOLLIN, [this](uint32) {
+    while (optional<Socket> sock = TryAccept(listener_))
+      on_accept_(std::move(*sock));
+  });
+}
+
+AsyncListener::~AsyncListener() { loop_.Remove(id_); }
+
+}  // namespace network
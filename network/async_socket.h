@@ -0,0 +1,109 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "network/event_loop.h"
+#include "network/socket.h"
+
+namespace network {
+
+// A non-blocking Socket driven by an EventLoop, so that one thread can serve
+// many connections.  Operations return at once and report completion by
+// calling back on the loop's thread.  Messages are framed as by
+// Socket::SendMessage, so the peer can use any of the socket classes.
+//
+// One receive may be outstanding at a time, and any number of sends.
+// Callbacks may start further operations and may destroy the socket.  If the
+// connection breaks, queued sends are dropped and a pending receive reports
+// end-of-stream.
+//
+// A received message larger than max_message_size, or that does not parse,
+// ends the stream too, so that a bad peer costs only its own connection.
+class AsyncSocket {
+ public:
+  AsyncSocket(EventLoop& loop, Socket sock,
+              uint64 max_message_size = std::numeric_limits<int>::max());
+  ~AsyncSocket();
+
+  // Receives the next message into message, which must stay alive until
+  // done is called: with true, or with false if the stream ends first.
+  void ReceiveMessage(protobuf::Message& message,
+                      std::function<void(bool received)> done);
+
+  // Serializes message at once and queues it for sending.  done, if given,
+  // is called once it has all been handed to the kernel.
+  void SendMessage(const protobuf::Message& message,
+                   std::function<void()> done = nullptr);
+
+  // Shuts down the sending side once everything queued has been sent.
+  void ShutdownWrite();
+
+  Socket& socket() { return sock_; }
+
+ private:
+  void HandleEvents(uint32 events);
+  void ReadInput();
+  void WriteOutput();
+  // Returns the next message in the input and its size, or nullptr if it
+  // has not all arrived.  Ends the stream if the message is too large.
+  const char* NextMessage(uint64& message_size);
+  void EndBadStream();
+  bool Deliverable();
+  // Runs the callbacks that are due.  Returns false if one of them
+  // destroyed the socket.
+  bool Deliver();
+  void Update();
+  void ScheduleDelivery();
+
+  EventLoop& loop_;
+  Socket sock_;
+  uint64 id_;
+  uint32 events_ = 0;
+  bool watching_ = true;
+  bool in_handler_ = false;
+  bool delivery_scheduled_ = false;
+  std::shared_ptr<bool> alive_;
+
+  const uint64 max_message_size_;
+  std::vector<char> in_;
+  size_t in_pos_ = 0;
+  size_t in_end_ = 0;
+  bool eof_ = false;
+  protobuf::Message* receive_message_ = nullptr;
+  std::function<void(bool)> receive_done_;
+
+  string out_;
+  size_t out_pos_ = 0;
+  uint64 sent_ = 0;
+  uint64 queued_ = 0;
+  std::deque<std::pair<uint64, std::function<void()>>> send_done_;
+  bool broken_ = false;
+  bool shutdown_pending_ = false;
+
+  AsyncSocket(const AsyncSocket&) = delete;
+  AsyncSocket& operator=(const AsyncSocket&) = delete;
+};
+
+// Accepts connections on a listening socket as they arrive, passing each to
+// on_accept as a non-blocking Socket.
+class AsyncListener {
+ public:
+  AsyncListener(EventLoop& loop, Socket listener,
+                std::function<void(Socket)> on_accept);
+  ~AsyncListener();
+
+ private:
+  EventLoop& loop_;
+  Socket listener_;
+  std::function<void(Socket)> on_accept_;
+  uint64 id_;
+
+  AsyncListener(const AsyncListener&) = delete;
+  AsyncListener& operator=(const AsyncListener&) = delete;
+};
+
+}  // namespace network
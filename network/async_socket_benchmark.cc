@@ -0,0 +1,172 @@
+#include <google/protobuf/descriptor.pb.h>
+#include <netinet/tcp.h>
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "core/must.h"
+#include "main/noargs.h"
+#include "network/async_socket.h"
+#include "network/buffered_socket.h"
+#include "network/socket.h"
+
+constexpr uint16 kPort = 35362;
+constexpr size_t kClientThreads = 4;
+constexpr float64 kSeconds = 2;
+
+network::Socket Listen() {
+  network::Socket listener;
+  listener.SetOptInt(SOL_SOCKET, SO_REUSEADDR, 1);
+  listener.Bind(kPort);
+  listener.Listen(SOMAXCONN);
+  return listener;
+}
+
+network::Socket Connect() {
+  network::Socket sock;
+  sock.Connect("127.0.0.1", std::to_string(kPort));
+  sock.SetOptInt(IPPROTO_TCP, TCP_NODELAY, 1);
+  return sock;
+}
+
+// Echoes every message back on one thread, with an AsyncSocket per
+// connection.
+class AsyncEchoServer {
+ public:
+  AsyncEchoServer()
+      : listener_(loop_, Listen(), [this](network::Socket sock) {
+          new Connection(loop_, std::move(sock));
+        }),
+        thread_([this] { loop_.Run(); }) {}
+
+  ~AsyncEchoServer() {
+    loop_.Stop();
+    thread_.join();
+  }
+
+ private:
+  struct Connection {
+    Connection(network::EventLoop& loop, network::Socket sock_)
+        : sock(loop, std::move(sock_)) {
+      Next();
+    }
+
+    void Next() {
+      sock.ReceiveMessage(message, [this](bool received) {
+        if (!received) {
+          delete this;
+          return;
+        }
+        sock.SendMessage(message);
+        Next();
+      });
+    }
+
+    network::AsyncSocket sock;
+    protobuf::FileDescriptorProto message;
+  };
+
+  network::EventLoop loop_;
+  network::AsyncListener listener_;
+  std::thread thread_;
+};
+
+// Echoes every message back with a thread per connection, the way the
+// blocking servers in the tree work.
+class BlockingEchoServer {
+ public:
+  BlockingEchoServer() : listener_(Listen()), thread_([this] { Serve(); }) {}
+
+  ~BlockingEchoServer() {
+    stopped_ = true;
+    Connect();
+    thread_.join();
+  }
+
+ private:
+  void Serve() {
+    while (true) {
+      network::Socket sock = Accept(listener_);
+      if (stopped_) return;
+      std::thread([](network::Socket sock) {
+        sock.SetOptInt(IPPROTO_TCP, TCP_NODELAY, 1);
+        protobuf::FileDescriptorProto message;
+        while (sock.ReceiveMessage(message)) sock.SendMessage(message);
+      }, std::move(sock)).detach();
+    }
+  }
+
+  network::Socket listener_;
+  std::atomic<bool> stopped_{false};
+  std::thread thread_;
+};
+
+// Runs fn on kClientThreads threads for kSeconds and returns the total of
+// what they return per second.
+template <typename F>
+float64 PerSecond(F fn) {
+  std::atomic<int64> total(0);
+  std::vector<std::thread> threads;
+  const float64 start = now_secs();
+  for (size_t i = 0; i < kClientThreads; i++)
+    threads.emplace_back([&, i] { total += fn(i, start + kSeconds); });
+  for (std::thread& t : threads) t.join();
+  return total / (now_secs() - start);
+}
+
+// A connection per exchange of one message.
+float64 ConnectionsPerSecond(const protobuf::Message& message) {
+  return PerSecond([&](size_t, float64 end) {
+    int64 connections = 0;
+    protobuf::FileDescriptorProto reply;
+    while (now_secs() < end) {
+      network::Socket sock = Connect();
+      sock.SendMessage(message);
+      MUST(sock.ReceiveMessage(reply));
+      connections++;
+    }
+    return connections;
+  });
+}
+
+// nconnections persistent connections, each exchanging messages in turn.
+float64 MessagesPerSecond(const protobuf::Message& message,
+                          size_t nconnections) {
+  return PerSecond([&](size_t index, float64 end) {
+    std::vector<network::BufferedSocket> socks;
+    for (size_t i = index; i < nconnections; i += kClientThreads)
+      socks.emplace_back(Connect());
+    int64 messages = 0;
+    protobuf::FileDescriptorProto reply;
+    while (now_secs() < end) {
+      for (network::BufferedSocket& sock : socks) {
+        sock.SendMessage(message);
+        sock.Flush();
+      }
+      for (network::BufferedSocket& sock : socks)
+        MUST(sock.ReceiveMessage(reply));
+      messages += socks.size();
+    }
+    return messages;
+  });
+}
+
+template <typename Server>
+void Report(const string& name, const protobuf::Message& message) {
+  Server server;
+  std::cout << name << ": " << int64(ConnectionsPerSecond(message))
+            << " connections/sec" << std::endl;
+  for (size_t nconnections : {1, 100, 1000})
+    std::cout << name << ": " << int64(MessagesPerSecond(message, nconnections))
+              << " messages/sec over " << nconnections << " connections"
+              << std::endl;
+}
+
+void Main() {
+  protobuf::FileDescriptorProto message;
+  message.set_name(string(100, 'x'));
+  Report<BlockingEchoServer>("blocking", message);
+  Report<AsyncEchoServer>("async", message);
+}
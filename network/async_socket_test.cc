@@ -0,0 +1,345 @@
+#include "network/async_socket.h"
+
+#include <google/protobuf/descriptor.pb.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "core/must.h"
+#include "gtest/gtest.h"
+
+using network::AsyncSocket;
+using network::EventLoop;
+using network::Socket;
+
+namespace {
+
+// Returns the two ends of a loopback connection.
+std::pair<Socket, Socket> ConnectedPair() {
+  Socket listener;
+  listener.Bind(0);
+  listener.Listen(1);
+  sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  if (getsockname(listener.fd(), (sockaddr*)&addr, &addr_len) != 0)
+    THROW_ERRNO("getsockname");
+  Socket client;
+  client.Connect("127.0.0.1", std::to_string(ntohs(addr.sin_port)));
+  return {std::move(client), Accept(listener)};
+}
+
+protobuf::FileDescriptorProto Named(const string& name) {
+  protobuf::FileDescriptorProto message;
+  message.set_name(name);
+  return message;
+}
+
+}  // namespace
+
+TEST(AsyncSocketTest, Echo) {
+  EventLoop loop;
+  std::pair<Socket, Socket> pair = ConnectedPair();
+  AsyncSocket sock(loop, std::move(pair.first));
+  std::thread peer([&] {
+    protobuf::FileDescriptorProto message;
+    while (pair.second.ReceiveMessage(message))
+      pair.second.SendMessage(message);
+    pair.second.Shutdown(SHUT_WR);
+  });
+
+  std::vector<string> replies;
+  protobuf::FileDescriptorProto reply;
+  std::function<void(bool)> on_reply = [&](bool received) {
+    ASSERT_TRUE(received);
+    replies.push_back(reply.name());
+    if (replies.size() == 3) {
+      sock.ShutdownWrite();
+      sock.ReceiveMessage(reply, [&](bool received) {
+        EXPECT_FALSE(received);
+        loop.Stop();
+      });
+    } else {
+      sock.ReceiveMessage(reply, on_reply);
+    }
+  };
+  for (const char* name : {"a", "b", "c"}) sock.SendMessage(Named(name));
+  sock.ReceiveMessage(reply, on_reply);
+  loop.Run();
+  peer.join();
+  EXPECT_EQ((std::vector<string>{"a", "b", "c"}), replies);
+}
+
+TEST(AsyncSocketTest, CallbackDestroysSocket) {
+  EventLoop loop;
+  std::pair<Socket, Socket> pair = ConnectedPair();
+  std::unique_ptr<AsyncSocket> sock(
+      new AsyncSocket(loop, std::move(pair.first)));
+  pair.second.SendMessage(Named("a"));
+  pair.second.SendMessage(Named("b"));
+
+  // From a send callback, with another one and a receive still due.
+  protobuf::FileDescriptorProto message;
+  int calls = 0;
+  sock->SendMessage(Named("out"), [&] {
+    calls++;
+    sock.reset();
+    loop.Post([&] { loop.Stop(); });
+  });
+  sock->SendMessage(Named("never"), [&] { ADD_FAILURE(); });
+  sock->ReceiveMessage(message, [&](bool) { ADD_FAILURE(); });
+  loop.Run();
+  EXPECT_EQ(1, calls);
+  EXPECT_FALSE(sock);
+
+  // From a receive callback, with the next message already buffered and a
+  // send callback due.
+  pair = ConnectedPair();
+  sock.reset(new AsyncSocket(loop, std::move(pair.first)));
+  pair.second.SendMessage(Named("a"));
+  pair.second.SendMessage(Named("b"));
+  std::function<void(bool)> on_message = [&](bool received) {
+    EXPECT_TRUE(received);
+    calls++;
+    sock->ReceiveMessage(message, [&](bool) { ADD_FAILURE(); });
+    sock->SendMessage(Named("out"), [&] { ADD_FAILURE(); });
+    sock.reset();
+    loop.Post([&] { loop.Stop(); });
+  };
+  sock->ReceiveMessage(message, on_message);
+  loop.Run();
+  EXPECT_EQ(2, calls);
+  EXPECT_FALSE(sock);
+}
+
+TEST(AsyncSocketTest, CallbackDestroysOtherSocket) {
+  // Both sockets have input before the loop runs, so a single epoll_wait
+  // reports both, and whichever is handled first destroys the other before
+  // its events are handled.
+  EventLoop loop;
+  std::pair<Socket, Socket> pairs[2] = {ConnectedPair(), ConnectedPair()};
+  std::unique_ptr<AsyncSocket> socks[2];
+  protobuf::FileDescriptorProto messages[2];
+  int calls = 0;
+  for (int i = 0; i < 2; i++) {
+    socks[i].reset(new AsyncSocket(loop, std::move(pairs[i].first)));
+    pairs[i].second.SendMessage(Named("x"));
+  }
+  // Let the input arrive, so that nothing is deliverable before Run.
+  Sleep(10ms);
+  for (int i = 0; i < 2; i++) {
+    socks[i]->ReceiveMessage(messages[i], [&, i](bool received) {
+      EXPECT_TRUE(received);
+      calls++;
+      socks[1 - i].reset();
+      loop.Post([&] { loop.Stop(); });
+    });
+  }
+  loop.Run();
+  EXPECT_EQ(1, calls);
+  EXPECT_NE(!socks[0], !socks[1]);
+}
+
+TEST(AsyncSocketTest, ReceiveBufferedMessage) {
+  EventLoop loop;
+  std::pair<Socket, Socket> pair = ConnectedPair();
+  AsyncSocket sock(loop, std::move(pair.first));
+  const protobuf::FileDescriptorProto sent[3] = {Named("a"), Named("b"),
+                                                 Named("c")};
+  const protobuf::Message* sent_ptrs[3] = {&sent[0], &sent[1], &sent[2]};
+  pair.second.SendMessages(sent_ptrs, 3);
+  pair.second.Shutdown(SHUT_WR);
+
+  // All three arrive in one read.  The second receive is issued from a
+  // callback, and the third from outside any, so it has to be delivered
+  // from the buffer without further input.
+  std::vector<string> received;
+  protobuf::FileDescriptorProto message;
+  sock.ReceiveMessage(message, [&](bool ok) {
+    ASSERT_TRUE(ok);
+    received.push_back(message.name());
+    sock.ReceiveMessage(message, [&](bool ok) {
+      ASSERT_TRUE(ok);
+      received.push_back(message.name());
+      loop.Post([&] {
+        sock.ReceiveMessage(message, [&](bool ok) {
+          ASSERT_TRUE(ok);
+          received.push_back(message.name());
+          sock.ReceiveMessage(message, [&](bool ok) {
+            EXPECT_FALSE(ok);
+            loop.Stop();
+          });
+        });
+      });
+    });
+  });
+  loop.Run();
+  EXPECT_EQ((std::vector<string>{"a", "b", "c"}), received);
+}
+
+TEST(AsyncSocketTest, PartialSends) {
+  // A message larger than the kernel buffers makes the sends partial, so
+  // the callbacks after it must wait for the peer to read.
+  EventLoop loop;
+  std::pair<Socket, Socket> pair = ConnectedPair();
+  AsyncSocket sock(loop, std::move(pair.first));
+  const string large(32 << 20, 'L');
+
+  std::vector<string> done;
+  sock.SendMessage(Named("small"), [&] { done.push_back("small"); });
+  sock.SendMessage(Named(large), [&] { done.push_back("large"); });
+  sock.SendMessage(Named("after"), [&] {
+    done.push_back("after");
+    sock.ShutdownWrite();
+  });
+  // Queued behind everything above, so the peer must see it all first.
+  sock.SendMessage(Named("last"));
+  EXPECT_TRUE(done.empty());
+
+  std::vector<string> received;
+  std::thread peer([&] {
+    protobuf::FileDescriptorProto message;
+    while (pair.second.ReceiveMessage(message)) {
+      received.push_back(message.name().size() == large.size()
+                             ? "large"
+                             : message.name());
+    }
+    loop.Stop();
+  });
+  loop.Run();
+  peer.join();
+  EXPECT_EQ((std::vector<string>{"small", "large", "after"}), done);
+  EXPECT_EQ((std::vector<string>{"small", "large", "after", "last"}),
+            received);
+}
+
+TEST(AsyncSocketTest, ReadsNoFurtherThanAMessage) {
+  EventLoop loop;
+  std::pair<Socket, Socket> pair = ConnectedPair();
+  AsyncSocket sock(loop, std::move(pair.first));
+  const protobuf::FileDescriptorProto small = Named(string(100, 's'));
+  const int kMessages = 20000;
+  std::thread peer([&] {
+    for (int i = 0; i < kMessages; i++) pair.second.SendMessage(small);
+    pair.second.Shutdown(SHUT_WR);
+  });
+  // Let plenty arrive before the first read.
+  Sleep(10ms);
+
+  protobuf::FileDescriptorProto message;
+  sock.ReceiveMessage(message, [&](bool received) {
+    EXPECT_TRUE(received);
+    loop.Stop();
+  });
+  loop.Run();
+
+  // Everything the AsyncSocket didn't read is still in the kernel.
+  size_t unread = 0;
+  sock.socket().SetNonBlocking(false);
+  char buffer[4096];
+  while (size_t received = sock.socket().TryReceive(buffer, sizeof(buffer)))
+    unread += received;
+  peer.join();
+  const size_t sent = kMessages * (1 + small.ByteSizeLong());
+  EXPECT_LE(sent - unread, size_t(64 << 10));
+}
+
+TEST(AsyncSocketTest, ShutdownWriteAfterQueuedOutput) {
+  EventLoop loop;
+  std::pair<Socket, Socket> pair = ConnectedPair();
+  AsyncSocket sock(loop, std::move(pair.first));
+  const string large(8 << 20, 'L');
+  for (int i = 0; i < 4; i++) sock.SendMessage(Named(large));
+  sock.ShutdownWrite();
+
+  int received = 0;
+  std::thread peer([&] {
+    protobuf::FileDescriptorProto message;
+    while (pair.second.ReceiveMessage(message)) {
+      EXPECT_EQ(large.size(), message.name().size());
+      received++;
+    }
+    loop.Stop();
+  });
+  loop.Run();
+  peer.join();
+  EXPECT_EQ(4, received);
+}
+
+TEST(AsyncSocketTest, PeerCloses) {
+  EventLoop loop;
+  std::pair<Socket, Socket> pair = ConnectedPair();
+  AsyncSocket sock(loop, std::move(pair.first));
+  protobuf::FileDescriptorProto message;
+  bool received = true;
+  sock.ReceiveMessage(message, [&](bool ok) {
+    received = ok;
+    loop.Stop();
+  });
+  { Socket closed = std::move(pair.second); }
+  loop.Run();
+  EXPECT_FALSE(received);
+}
+
+TEST(AsyncSocketTest, BadMessagesEndStream) {
+  const string bad_inputs[] = {
+      string(1, char(101)) + string(101, 'x'),  // over max_message_size
+      string("\x03\xff\xff\xff", 4),            // does not parse
+      string(12, '\xff'),                       // size prefix overflows
+  };
+  for (const string& bad : bad_inputs) {
+    EventLoop loop;
+    std::pair<Socket, Socket> pair = ConnectedPair();
+    AsyncSocket sock(loop, std::move(pair.first), 100);
+    pair.second.SendMessage(Named("good"));
+    pair.second.Send(bad.data(), bad.size());
+    pair.second.SendMessage(Named("unread"));
+
+    std::vector<string> received;
+    protobuf::FileDescriptorProto message;
+    std::function<void(bool)> on_message = [&](bool ok) {
+      if (!ok) {
+        loop.Stop();
+        return;
+      }
+      received.push_back(message.name());
+      sock.ReceiveMessage(message, on_message);
+    };
+    sock.ReceiveMessage(message, on_message);
+    loop.Run();
+    EXPECT_EQ((std::vector<string>{"good"}), received);
+  }
+}
+
+TEST(EventLoopTest, StopFromAnotherThread) {
+  EventLoop loop;
+  for (int i = 0; i < 3; i++) {
+    std::thread stopper([&] {
+      Sleep(10ms);
+      loop.Stop();
+    });
+    loop.Run();
+    stopper.join();
+  }
+}
+
+TEST(EventLoopTest, RemoveFromHandler) {
+  EventLoop loop;
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  int calls = 0;
+  uint64 id = 0;
+  id = loop.Add(fds[0], EPOLLIN, [&](uint32) {
+    calls++;
+    loop.Remove(id);
+    loop.Post([&] { loop.Stop(); });
+  });
+  ASSERT_EQ(1, write(fds[1], "x", 1));
+  loop.Run();
+  EXPECT_EQ(1, calls);
+  close(fds[0]);
+  close(fds[1]);
+}
@@ -0,0 +1,213 @@
+#include "network/buffered_socket.h"
+
+#include <netinet/tcp.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "core/must.h"
+
+namespace network {
+
+BufferedSocket::BufferedSocket(Socket sock, size_t buffer_size)
+    : sock_(std::move(sock)),
+      send_buffer_(std::max(buffer_size, kMaxPackedUint64Size)),
+      receive_buffer_(std::max(buffer_size, kMaxPackedUint64Size)) {
+  sock_.SetOptInt(IPPROTO_TCP, TCP_NODELAY, 1);
+}
+
+BufferedSocket::BufferedSocket(BufferedSocket&& that)
+    : sock_(std::move(that.sock_)),
+      send_buffer_(std::move(that.send_buffer_)),
+      send_size_(that.send_size_),
+      receive_buffer_(std::move(that.receive_buffer_)),
+      receive_pos_(that.receive_pos_),
+      receive_end_(that.receive_end_),
+      message_buffer_(std::move(that.message_buffer_)) {
+  that.send_size_ = that.receive_pos_ = that.receive_end_ = 0;
+}
+
+BufferedSocket& BufferedSocket::operator=(BufferedSocket&& that) {
+  Flush();
+  sock_ = std::move(that.sock_);
+  send_buffer_ = std::move(that.send_buffer_);
+  send_size_ = that.send_size_;
+  receive_buffer_ = std::move(that.receive_buffer_);
+  receive_pos_ = that.receive_pos_;
+  receive_end_ = that.receive_end_;
+  message_buffer_ = std::move(that.message_buffer_);
+  that.send_size_ = that.receive_pos_ = that.receive_end_ = 0;
+  return *this;
+}
+
+BufferedSocket::~BufferedSocket() {
+  // A destructor must not throw, and may be running because of another
+  // error, so anything that can't be sent now is dropped.
+  try {
+    Flush();
+  } catch (...) {
+  }
+}
+
+void BufferedSocket::Send(const void* buf, size_t len) {
+  if (len > send_buffer_.size() - send_size_) {
+    // Too big to be worth copying: send it as is, along with what is
+    // buffered, in one system call.
+    if (len >= send_buffer_.size()) {
+      iovec iov[2] = {{send_buffer_.data(), send_size_},
+                      {const_cast<void*>(buf), len}};
+      send_size_ = 0;
+      sock_.SendGathered(iov, 2);
+      return;
+    }
+    Flush();
+  }
+  std::memcpy(send_buffer_.data() + send_size_, buf, len);
+  send_size_ += len;
+}
+
+void BufferedSocket::SendInteger(bigint n) {
+  const string packed = pack_bigint(n);
+  Send(packed.data(), packed.size());
+}
+
+void BufferedSocket::SendUint64(uint64 n) {
+  if (send_buffer_.size() - send_size_ < kMaxPackedUint64Size) Flush();
+  send_size_ += pack_uint64(n, send_buffer_.data() + send_size_);
+}
+
+void BufferedSocket::SendString(string_view str) {
+  SendUint64(str.size());
+  Send(str.data(), str.size());
+}
+
+void BufferedSocket::SendMessage(const protobuf::Message& message) {
+  const size_t message_size = message.ByteSizeLong();
+  const size_t max_size = kMaxPackedUint64Size + message_size;
+  if (max_size > send_buffer_.size()) {
+    if (message_buffer_.size() < message_size)
+      message_buffer_.resize(message_size);
+    message.SerializeWithCachedSizesToArray((uint8*)message_buffer_.data());
+    SendUint64(message_size);
+    Send(message_buffer_.data(), message_size);
+    return;
+  }
+  if (max_size > send_buffer_.size() - send_size_) Flush();
+  char* out = send_buffer_.data() + send_size_;
+  out += pack_uint64(message_size, out);
+  out = (char*)message.SerializeWithCachedSizesToArray((uint8*)out);
+  send_size_ = out - send_buffer_.data();
+}
+
+void BufferedSocket::Flush() {
+  if (send_size_ == 0) return;
+  sock_.Send(send_buffer_.data(), send_size_);
+  send_size_ = 0;
+}
+
+bool BufferedSocket::Fill() {
+  if (receive_pos_ != 0) {
+    std::memmove(receive_buffer_.data(), receive_buffer_.data() + receive_pos_,
+                 receive_end_ - receive_pos_);
+    receive_end_ -= receive_pos_;
+    receive_pos_ = 0;
+  }
+  const size_t received =
+      sock_.TryReceive(receive_buffer_.data() + receive_end_,
+                       receive_buffer_.size() - receive_end_);
+  receive_end_ += received;
+  return received != 0;
+}
+
+size_t BufferedSocket::TryReceive(void* buf, size_t len) {
+  if (len == 0) return 0;
+  if (receive_pos_ == receive_end_) {
+    // Large reads skip the buffer.
+    if (len >= receive_buffer_.size()) return sock_.TryReceive(buf, len);
+    if (!Fill()) return 0;
+  }
+  const size_t n = std::min(len, receive_end_ - receive_pos_);
+  std::memcpy(buf, receive_buffer_.data() + receive_pos_, n);
+  receive_pos_ += n;
+  return n;
+}
+
+void BufferedSocket::Receive(void* buf, size_t len) {
+  char* ptr = static_cast<char*>(buf);
+  const char* end = ptr + len;
+  while (ptr < end) {
+    size_t received_bytes = TryReceive(ptr, end - ptr);
+    if (received_bytes == 0) FAIL("Unexpected end-of-stream.");
+    ptr += received_bytes;
+  }
+}
+
+optional<uint8> BufferedSocket::ReceiveByte() {
+  if (receive_pos_ == receive_end_ && !Fill()) return nullopt;
+  return uint8(receive_buffer_[receive_pos_++]);
+}
+
+optional<bigint> BufferedSocket::ReceiveInteger() {
+  optional<uint8> m = ReceiveByte();
+  if (!m) return nullopt;
+  bigint result = (*m & 0b0111'1111);
+  while (*m & 0b1000'0000) {
+    m = ReceiveByte();
+    if (!m) FAIL("Unexpected end-of-stream.");
+    result <<= 7;
+    result |= (*m & 0b0111'1111);
+  }
+  return result;
+}
+
+optional<uint64> BufferedSocket::ReceiveUint64() {
+  while (true) {
+    uint64 n;
+    const char* begin = receive_buffer_.data() + receive_pos_;
+    const char* end = receive_buffer_.data() + receive_end_;
+    if (const char* next = unpack_uint64(begin, end, n)) {
+      receive_pos_ += next - begin;
+      return n;
+    }
+    const bool empty = begin == end;
+    if (!Fill()) {
+      if (empty) return nullopt;
+      FAIL("Unexpected end-of-stream.");
+    }
+  }
+}
+
+optional<string> BufferedSocket::ReceiveString() {
+  optional<uint64> string_length = ReceiveUint64();
+  if (!string_length) return nullopt;
+  string result(size_t(*string_length), '\0');
+  Receive(&result[0], result.size());
+  return result;
+}
+
+bool BufferedSocket::ReceiveMessage(protobuf::Message& message) {
+  optional<uint64> message_size = ReceiveUint64();
+  if (!message_size) return false;
+  const char* data;
+  if (*message_size <= receive_buffer_.size()) {
+    while (receive_end_ - receive_pos_ < *message_size)
+      if (!Fill()) FAIL("Unexpected end-of-stream.");
+    data = receive_buffer_.data() + receive_pos_;
+    receive_pos_ += *message_size;
+  } else {
+    if (message_buffer_.size() < *message_size)
+      message_buffer_.resize(*message_size);
+    Receive(message_buffer_.data(), *message_size);
+    data = message_buffer_.data();
+  }
+  if (!message.ParseFromArray(data, int(*message_size)))
+    FAIL("ParseFromArray failed.");
+  return true;
+}
+
+void BufferedSocket::Shutdown(int how) {
+  if (how == SHUT_WR || how == SHUT_RDWR) Flush();
+  sock_.Shutdown(how);
+}
+
+}  // namespace network
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+
+#include "network/socket.h"
+
+namespace network {
+
+// A Socket with userspace send and receive buffers.  It speaks the same wire
+// format as Socket, so either end of a connection can use either class, but
+// the integer, string and message calls cost a memcpy rather than a system
+// call or two each.
+//
+// Messages are serialized straight into the send buffer and parsed straight
+// out of the receive buffer.  Only messages bigger than the buffers go
+// through a separate, reused, buffer.
+//
+// Sends are only buffered: nothing reaches the peer until the buffer fills
+// or Flush is called.  Since the buffer already coalesces small writes,
+// Nagle's algorithm is turned off and Flush is just a send.
+class BufferedSocket {
+ public:
+  explicit BufferedSocket(Socket sock, size_t buffer_size = 64 << 10);
+  BufferedSocket(BufferedSocket&& that);
+  BufferedSocket& operator=(BufferedSocket&& that);
+
+  // Flushes anything still buffered, ignoring errors.  Call Flush or
+  // Shutdown first to find out whether it was sent.
+  ~BufferedSocket();
+
+  void Send(const void* buf, size_t len);
+  void SendInteger(bigint n);
+  void SendUint64(uint64 n);
+  void SendString(string_view str);
+  void SendMessage(const protobuf::Message& message);
+
+  // Writes everything buffered so far to the socket.
+  void Flush();
+
+  // Receives at least one and at most len bytes, or zero at end-of-stream.
+  size_t TryReceive(void* buf, size_t len);
+  void Receive(void* buf, size_t len);
+  optional<bigint> ReceiveInteger();
+  optional<uint64> ReceiveUint64();
+  optional<string> ReceiveString();
+  [[gnu::warn_unused_result]] bool ReceiveMessage(protobuf::Message& message);
+
+  // Flushes first if how includes SHUT_WR.
+  void Shutdown(int how);
+
+  Socket& socket() { return sock_; }
+
+ private:
+  // Reads more input, moving what is left to the front of the buffer first.
+  // Returns false at end-of-stream.
+  bool Fill();
+  optional<uint8> ReceiveByte();
+
+  Socket sock_;
+  std::vector<char> send_buffer_;
+  size_t send_size_ = 0;
+  std::vector<char> receive_buffer_;
+  size_t receive_pos_ = 0;
+  size_t receive_end_ = 0;
+  std::vector<char> message_buffer_;
+
+  BufferedSocket(const BufferedSocket&) = delete;
+  BufferedSocket& operator=(const BufferedSocket&) = delete;
+};
+
+}  // namespace network
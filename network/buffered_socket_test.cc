@@ -0,0 +1,201 @@
+#include "network/buffered_socket.h"
+
+#include <google/protobuf/descriptor.pb.h>
+#include <signal.h>
+
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "core/must.h"
+#include "gtest/gtest.h"
+
+using network::BufferedSocket;
+using network::Socket;
+
+namespace {
+
+// Returns the two ends of a loopback connection.
+std::pair<Socket, Socket> ConnectedPair() {
+  Socket listener;
+  listener.Bind(0);
+  listener.Listen(1);
+  sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  if (getsockname(listener.fd(), (sockaddr*)&addr, &addr_len) != 0)
+    THROW_ERRNO("getsockname");
+  Socket client;
+  client.Connect("127.0.0.1", std::to_string(ntohs(addr.sin_port)));
+  return {std::move(client), Accept(listener)};
+}
+
+// A message whose serialized size is exactly size, for sizes from 2 to 129.
+protobuf::FileDescriptorProto MessageOfSize(size_t size) {
+  MUST_GE(size, 2u);
+  MUST_LE(size, 129u);
+  protobuf::FileDescriptorProto message;
+  message.set_name(string(size - 2, 'a' + size % 26));
+  MUST_EQ(message.ByteSizeLong(), size);
+  return message;
+}
+
+// Receives from a BufferedSocket with a small buffer what a plain Socket
+// sent, all of which has arrived before the first Fill.
+BufferedSocket ReceiverOf(const string& sent, size_t buffer_size) {
+  std::pair<Socket, Socket> pair = ConnectedPair();
+  pair.first.Send(sent.data(), sent.size());
+  pair.first.Shutdown(SHUT_WR);
+  return BufferedSocket(std::move(pair.second), buffer_size);
+}
+
+}  // namespace
+
+TEST(BufferedSocketTest, IntegerStraddlesFill) {
+  // The first Fill of 16 bytes ends inside the third byte of 1 << 20.
+  string sent(14, '\x05');
+  sent += string("\xc0\x80\x00\x07", 4);
+  BufferedSocket receiver = ReceiverOf(sent, 16);
+  for (int i = 0; i < 14; i++)
+    EXPECT_EQ(5u, receiver.ReceiveUint64().value());
+  EXPECT_EQ(uint64(1) << 20, receiver.ReceiveUint64().value());
+  EXPECT_EQ(7u, receiver.ReceiveUint64().value());
+  EXPECT_FALSE(receiver.ReceiveUint64());
+}
+
+TEST(BufferedSocketTest, MessageStraddlesFill) {
+  std::pair<Socket, Socket> pair = ConnectedPair();
+  for (int i = 0; i < 10; i++) pair.first.SendUint64(i);
+  pair.first.SendMessage(MessageOfSize(12));
+  pair.first.Shutdown(SHUT_WR);
+
+  BufferedSocket receiver(std::move(pair.second), 16);
+  for (int i = 0; i < 10; i++)
+    EXPECT_EQ(uint64(i), receiver.ReceiveUint64().value());
+  protobuf::FileDescriptorProto message;
+  ASSERT_TRUE(receiver.ReceiveMessage(message));
+  EXPECT_EQ(MessageOfSize(12).name(), message.name());
+  EXPECT_FALSE(receiver.ReceiveMessage(message));
+}
+
+TEST(BufferedSocketTest, MessageSizes) {
+  // Around the 64 byte buffer, and much bigger, so that both ends go
+  // through their message buffers.
+  for (size_t name_size : {0, 10, 60, 61, 62, 63, 64, 65, 1000, 100000}) {
+    protobuf::FileDescriptorProto sent;
+    sent.set_name(string(name_size, 'x'));
+    std::pair<Socket, Socket> pair = ConnectedPair();
+    std::thread sender([&] {
+      BufferedSocket sock(std::move(pair.first), 64);
+      for (int i = 0; i < 3; i++) sock.SendMessage(sent);
+      sock.Shutdown(SHUT_WR);
+    });
+    BufferedSocket receiver(std::move(pair.second), 64);
+    for (int i = 0; i < 3; i++) {
+      protobuf::FileDescriptorProto message;
+      ASSERT_TRUE(receiver.ReceiveMessage(message));
+      EXPECT_EQ(sent.name(), message.name()) << name_size;
+    }
+    protobuf::FileDescriptorProto message;
+    EXPECT_FALSE(receiver.ReceiveMessage(message));
+    sender.join();
+  }
+}
+
+TEST(BufferedSocketTest, MessageExactlyBufferSize) {
+  std::pair<Socket, Socket> pair = ConnectedPair();
+  pair.first.SendMessage(MessageOfSize(64));
+  pair.first.SendMessage(MessageOfSize(64));
+  pair.first.Shutdown(SHUT_WR);
+
+  BufferedSocket receiver(std::move(pair.second), 64);
+  for (int i = 0; i < 2; i++) {
+    protobuf::FileDescriptorProto message;
+    ASSERT_TRUE(receiver.ReceiveMessage(message));
+    EXPECT_EQ(MessageOfSize(64).name(), message.name());
+  }
+}
+
+TEST(BufferedSocketTest, LargeSendIsGathered) {
+  string large(1 << 20, '\0');
+  for (size_t i = 0; i < large.size(); i++) large[i] = char(i * 7);
+  std::pair<Socket, Socket> pair = ConnectedPair();
+  std::thread sender([&] {
+    BufferedSocket sock(std::move(pair.first), 64);
+    sock.SendUint64(1);
+    sock.Send(large.data(), large.size());
+    sock.SendUint64(2);
+    sock.SendString(large);
+    sock.Shutdown(SHUT_WR);
+  });
+  BufferedSocket receiver(std::move(pair.second), 64);
+  EXPECT_EQ(1u, receiver.ReceiveUint64().value());
+  string received(large.size(), '\0');
+  receiver.Receive(&received[0], received.size());
+  EXPECT_TRUE(received == large);
+  EXPECT_EQ(2u, receiver.ReceiveUint64().value());
+  EXPECT_TRUE(receiver.ReceiveString().value() == large);
+  EXPECT_FALSE(receiver.ReceiveUint64());
+  sender.join();
+}
+
+TEST(BufferedSocketTest, InteroperatesWithSocket) {
+  const bigint big = bigint(1) << 100;
+  std::pair<Socket, Socket> pair = ConnectedPair();
+  // A negative int goes to the bigint encoding, which rejects it, rather
+  // than being sent as a wrapped around uint64.
+  EXPECT_THROW(pair.first.SendInteger(-1), std::exception);
+  std::thread plain([&] {
+    Socket& sock = pair.second;
+    EXPECT_EQ(42u, sock.ReceiveUint64().value());
+    EXPECT_TRUE(sock.ReceiveInteger().value() == big);
+    EXPECT_EQ("hello", sock.ReceiveString().value());
+    protobuf::FileDescriptorProto message;
+    ASSERT_TRUE(sock.ReceiveMessage(message));
+    EXPECT_EQ(MessageOfSize(100).name(), message.name());
+    EXPECT_FALSE(sock.ReceiveUint64());
+
+    sock.SendUint64(43);
+    sock.SendInteger(big + 1);
+    sock.SendString("world");
+    sock.SendMessage(MessageOfSize(120));
+    sock.Shutdown(SHUT_WR);
+  });
+
+  BufferedSocket buffered(std::move(pair.first), 32);
+  buffered.SendUint64(42);
+  buffered.SendInteger(big);
+  buffered.SendString("hello");
+  buffered.SendMessage(MessageOfSize(100));
+  buffered.Shutdown(SHUT_WR);
+
+  EXPECT_EQ(43u, buffered.ReceiveUint64().value());
+  EXPECT_TRUE(buffered.ReceiveInteger().value() == big + 1);
+  EXPECT_EQ("world", buffered.ReceiveString().value());
+  protobuf::FileDescriptorProto message;
+  ASSERT_TRUE(buffered.ReceiveMessage(message));
+  EXPECT_EQ(MessageOfSize(120).name(), message.name());
+  EXPECT_FALSE(buffered.ReceiveUint64());
+  plain.join();
+}
+
+TEST(BufferedSocketTest, DestroyAfterPeerCloses) {
+  // Errors then surface from send rather than as a signal.
+  signal(SIGPIPE, SIG_IGN);
+  for (bool unwinding : {false, true}) {
+    std::pair<Socket, Socket> pair = ConnectedPair();
+    // Closing with unread input resets the connection.
+    pair.first.SendUint64(1);
+    { Socket closed = std::move(pair.second); }
+    Sleep(10ms);
+
+    try {
+      BufferedSocket buffered(std::move(pair.first));
+      buffered.SendString("lost");
+      if (unwinding) throw std::runtime_error("unwinding");
+      EXPECT_THROW(buffered.Flush(), std::exception);
+      buffered.SendString("also lost");
+    } catch (const std::runtime_error& e) {
+      EXPECT_TRUE(unwinding);
+    }
+  }
+}
@@ -0,0 +1,97 @@
+#include "network/event_loop.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "core/must.h"
+
+namespace network {
+
+// The epoll data of the wake-up eventfd.  Watch ids start at 1.
+constexpr uint64 kWakeId = 0;
+
+EventLoop::EventLoop() {
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ == -1) THROW_ERRNO("epoll_create1");
+  wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (wake_fd_ == -1) THROW_ERRNO("eventfd");
+  epoll_event event;
+  event.events = EPOLLIN;
+  event.data.u64 = kWakeId;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event) != 0)
+    THROW_ERRNO("epoll_ctl");
+}
+
+EventLoop::~EventLoop() {
+  close(wake_fd_);
+  close(epoll_fd_);
+}
+
+uint64 EventLoop::Add(int fd, uint32 events, Handler handler) {
+  const uint64 id = next_id_++;
+  epoll_event event;
+  event.events = events;
+  event.data.u64 = id;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0)
+    THROW_ERRNO("epoll_ctl(EPOLL_CTL_ADD)");
+  watches_[id].reset(new Watch{fd, std::move(handler)});
+  return id;
+}
+
+void EventLoop::Modify(uint64 id, uint32 events) {
+  epoll_event event;
+  event.events = events;
+  event.data.u64 = id;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, watches_.at(id)->fd, &event) != 0)
+    THROW_ERRNO("epoll_ctl(EPOLL_CTL_MOD)");
+}
+
+void EventLoop::Remove(uint64 id) {
+  auto it = watches_.find(id);
+  MUST(it != watches_.end());
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, it->second->fd, nullptr) != 0)
+    THROW_ERRNO("epoll_ctl(EPOLL_CTL_DEL)");
+  removed_.push_back(std::move(it->second));
+  watches_.erase(it);
+}
+
+void EventLoop::Post(Task task) { tasks_.push_back(std::move(task)); }
+
+void EventLoop::RunTasks() {
+  std::vector<Task> tasks;
+  tasks.swap(tasks_);
+  for (Task& task : tasks) task();
+  removed_.clear();
+}
+
+void EventLoop::Run() {
+  std::vector<epoll_event> events(256);
+  while (!stopped_) {
+    RunTasks();
+    if (stopped_) break;
+    const int nevents = epoll_wait(epoll_fd_, events.data(),
+                                   int(events.size()), tasks_.empty() ? -1 : 0);
+    if (nevents == -1) {
+      if (errno == EINTR) continue;
+      THROW_ERRNO("epoll_wait");
+    }
+    for (int i = 0; i < nevents && !stopped_; i++) {
+      auto it = watches_.find(events[i].data.u64);
+      if (it != watches_.end()) it->second->handler(events[i].events);
+    }
+    removed_.clear();
+  }
+  stopped_ = false;
+  uint64 count;
+  if (read(wake_fd_, &count, sizeof(count)) == -1 && errno != EAGAIN)
+    THROW_ERRNO("read(eventfd)");
+}
+
+void EventLoop::Stop() {
+  stopped_ = true;
+  const uint64 one = 1;
+  if (write(wake_fd_, &one, sizeof(one)) == -1) THROW_ERRNO("write(eventfd)");
+}
+
+}  // namespace network
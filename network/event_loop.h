@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace network {
+
+// Calls handlers from a single thread as file descriptors become ready, using
+// epoll.  Apart from Stop, a loop and everything registered with it must
+// only be used from the thread that runs it.
+class EventLoop {
+ public:
+  using Handler = std::function<void(uint32 events)>;
+  using Task = std::function<void()>;
+
+  EventLoop();
+  ~EventLoop();
+
+  // Watches fd for events (EPOLLIN, EPOLLOUT, ...), calling handler with the
+  // ones that occur.  EPOLLERR and EPOLLHUP are always watched.  Returns an
+  // id for Modify and Remove.
+  uint64 Add(int fd, uint32 events, Handler handler);
+  void Modify(uint64 id, uint32 events);
+
+  // Stops watching.  The handler is not called again, even for events that
+  // were already collected, but it may be the handler doing the removing:
+  // it is only destroyed once it has returned.
+  void Remove(uint64 id);
+
+  // Runs task on the loop's thread once the current handler has returned.
+  void Post(Task task);
+
+  // Handles events until Stop is called.
+  void Run();
+
+  // Makes Run return after the current handler.  May be called from any
+  // thread.
+  void Stop();
+
+ private:
+  struct Watch {
+    int fd;
+    Handler handler;
+  };
+
+  void RunTasks();
+
+  int epoll_fd_;
+  int wake_fd_;
+  std::atomic<bool> stopped_{false};
+  uint64 next_id_ = 1;
+  std::unordered_map<uint64, std::unique_ptr<Watch>> watches_;
+  std::vector<std::unique_ptr<Watch>> removed_;
+  std::vector<Task> tasks_;
+
+  EventLoop(const EventLoop&) = delete;
+  EventLoop& operator=(const EventLoop&) = delete;
+};
+
+}  // namespace network
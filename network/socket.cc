@@ -1,12 +1,16 @@
 #include "network/socket.h"
 
+#include <algorithm>
+#include <climits>
 #include <cstring>
+#include <fcntl.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <vector>
 
 #include "core/must.h"
 
@@ -55,6 +59,16 @@ Socket Accept(const Socket& sock) {
   return Socket(accept_result);
 }
 
+optional<Socket> TryAccept(const Socket& sock) {
+  int accept_result = accept4(sock.fd_, nullptr, nullptr, SOCK_NONBLOCK);
+  if (accept_result == -1) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNABORTED)
+      return nullopt;
+    THROW_ERRNO("accept4");
+  }
+  return Socket(accept_result);
+}
+
 void Socket::Connect(const string& node, const string& service) {
   addrinfo hints;
   std::memset(&hints, 0, sizeof(addrinfo));
@@ -93,28 +107,66 @@ void Socket::Send(const void* const buf, const size_t len) {
 }
 
 void Socket::SendInteger(bigint n) {
-  std::vector<uint8> ne;
-  do {
-    uint8 m = (uint8(n) & 0b0111'1111);
-    n >>= 7;
-    m |= 0b1000'0000;
-    ne.push_back(m);
-  } while (n > 0);
-  Reverse(ne);
-  ne.back() &= 0b0111'1111;
-  Send(ne.data(), ne.size());
+  const string packed = pack_bigint(n);
+  Send(packed.data(), packed.size());
+}
+
+void Socket::SendUint64(uint64 n) {
+  char packed[kMaxPackedUint64Size];
+  Send(packed, pack_uint64(n, packed));
 }
 
 void Socket::SendString(const string& str) {
-  SendInteger(str.size());
+  SendUint64(str.size());
   Send(str.data(), str.size());
 }
 
+// A buffer for serialized messages, reused so that sending or receiving a
+// message need not allocate.
+static std::vector<char>& MessageBuffer() {
+  thread_local std::vector<char> buffer;
+  return buffer;
+}
+
 void Socket::SendMessage(const protobuf::Message& message) {
-  string message_string;
-  if (!message.SerializeToString(&message_string))
-    FAIL("SerializeToString failed.");
-  SendString(message_string);
+  const protobuf::Message* const messages[] = {&message};
+  SendMessages(messages, 1);
+}
+
+void Socket::SendMessages(const protobuf::Message* const* messages,
+                          size_t count) {
+  size_t max_size = 0;
+  for (size_t i = 0; i < count; i++)
+    max_size += kMaxPackedUint64Size + messages[i]->ByteSizeLong();
+  std::vector<char>& buffer = MessageBuffer();
+  if (buffer.size() < max_size) buffer.resize(max_size);
+  char* out = buffer.data();
+  for (size_t i = 0; i < count; i++) {
+    out += pack_uint64(messages[i]->GetCachedSize(), out);
+    out = (char*)messages[i]->SerializeWithCachedSizesToArray((uint8*)out);
+  }
+  Send(buffer.data(), out - buffer.data());
+}
+
+void Socket::SendGathered(iovec* iov, size_t count) {
+  while (count > 0) {
+    const ssize_t writev_result =
+        writev(fd_, iov, int(std::min<size_t>(count, IOV_MAX)));
+    if (writev_result == -1) {
+      if (errno == EINTR) continue;
+      THROW_ERRNO("writev");
+    }
+    size_t written = writev_result;
+    while (count > 0 && written >= iov->iov_len) {
+      written -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0) {
+      iov->iov_base = (char*)iov->iov_base + written;
+      iov->iov_len -= written;
+    }
+  }
 }
 
 size_t Socket::TryReceive(void* const buf, const size_t len) {
@@ -149,10 +201,17 @@ optional<bigint> Socket::ReceiveInteger() {
   return result;
 }
 
+optional<uint64> Socket::ReceiveUint64() {
+  return unpack_uint64([&]() -> optional<uint8> {
+    uint8 m;
+    if (TryReceive(&m, 1) == 0) return nullopt;
+    return m;
+  });
+}
+
 optional<string> Socket::ReceiveString() {
-  optional<bigint> string_length = ReceiveInteger();
+  optional<uint64> string_length = ReceiveUint64();
   if (!string_length) return nullopt;
-  MUST_LE(*string_length, std::numeric_limits<size_t>::max());
   string result(size_t(*string_length), '\0');
   Receive(&result[0], result.size());
   return result;
@@ -160,11 +219,13 @@ optional<string> Socket::ReceiveString() {
 
 [[gnu::warn_unused_result]] bool Socket::ReceiveMessage(
     protobuf::Message& message) {
-  optional<string> message_string = ReceiveString();
-  if (!message_string) return false;
-  const bool parse_success = message.ParseFromString(*message_string);
-  if (!parse_success) {
-    FAIL("ParseFromString failed.");
+  optional<uint64> message_size = ReceiveUint64();
+  if (!message_size) return false;
+  std::vector<char>& buffer = MessageBuffer();
+  if (buffer.size() < *message_size) buffer.resize(*message_size);
+  Receive(buffer.data(), *message_size);
+  if (!message.ParseFromArray(buffer.data(), int(*message_size))) {
+    FAIL("ParseFromArray failed.");
   }
   return true;
 }
@@ -181,6 +242,13 @@ void Socket::Flush() {
   SetOptInt(IPPROTO_TCP, TCP_NODELAY, 0);
 }
 
+void Socket::SetNonBlocking(bool nonblocking) {
+  int flags = fcntl(fd_, F_GETFL);
+  if (flags == -1) THROW_ERRNO("fcntl(F_GETFL)");
+  flags = nonblocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+  if (fcntl(fd_, F_SETFL, flags) == -1) THROW_ERRNO("fcntl(F_SETFL)");
+}
+
 void Socket::GetOpt(int level, int optname, void* optval, socklen_t* optlen) {
   int getsockopt_result = getsockopt(fd_, level, optname, optval, optlen);
   if (getsockopt_result != 0) THROW_ERRNO("getsockopt");
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <netinet/ip.h>
 #include <google/protobuf/message.h>
@@ -30,12 +31,24 @@ class Socket {
   size_t TrySend(const void* buf, size_t len);
   void Send(const void* buf, size_t len);
   void SendInteger(bigint n);
+  // Sends the same bytes as SendInteger(bigint(n)), without a bigint.
+  void SendUint64(uint64 n);
   void SendString(const string& str);
   void SendMessage(const protobuf::Message& message);
 
+  // Frames count messages exactly as count calls to SendMessage would, but
+  // serializes them all into one reused buffer and sends them with as few
+  // system calls as possible.
+  void SendMessages(const protobuf::Message* const* messages, size_t count);
+
+  // Sends the buffers of iov in order with writev, so that separately held
+  // pieces need not be copied together first.  Modifies iov.
+  void SendGathered(iovec* iov, size_t count);
+
   size_t TryReceive(void* buf, size_t len);
   void Receive(void* buf, size_t len);
   optional<bigint> ReceiveInteger();
+  optional<uint64> ReceiveUint64();
   optional<string> ReceiveString();
   [[gnu::warn_unused_result]] bool ReceiveMessage(protobuf::Message& message);
 
@@ -49,6 +62,12 @@ class Socket {
   void SetOpt(int level, int optname, const void* optval, socklen_t optlen);
   void SetOptInt(int level, int optname, int optval);
 
+  // In non-blocking mode the calls above throw with errno EAGAIN instead of
+  // waiting.  Used by servers that poll many sockets with epoll.
+  void SetNonBlocking(bool nonblocking);
+
+  int fd() const { return fd_; }
+
  private:
   Socket(int fd) : fd_(fd) {}
   int fd_;
@@ -57,8 +76,13 @@ class Socket {
   Socket& operator=(const Socket&) = delete;
 
   friend Socket Accept(const Socket& sock);
+  friend optional<Socket> TryAccept(const Socket& sock);
 };
 
 Socket Accept(const Socket& sock);
 
+// Like Accept, but for a non-blocking listening socket: returns nullopt if
+// no connection is waiting.  The accepted socket is non-blocking too.
+optional<Socket> TryAccept(const Socket& sock);
+
 }  // namespace network
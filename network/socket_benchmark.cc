@@ -0,0 +1,165 @@
+#include <google/protobuf/descriptor.pb.h>
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "core/must.h"
+#include "main/noargs.h"
+#include "network/buffered_socket.h"
+#include "network/socket.h"
+
+constexpr uint16 kPort = 35359;
+
+// Runs server on one end of a loopback connection and client on the other,
+// and reports how many items per second made it across.
+template <typename Server, typename Client>
+void Report(const string& name, int64 items, Server server, Client client) {
+  network::Socket listener;
+  listener.SetOptInt(SOL_SOCKET, SO_REUSEADDR, 1);
+  listener.Bind(kPort);
+  listener.Listen(1);
+  std::thread server_thread([&] { server(Accept(listener)); });
+  const float64 start = now_secs();
+  network::Socket sock;
+  sock.Connect("127.0.0.1", std::to_string(kPort));
+  client(std::move(sock));
+  server_thread.join();
+  const float64 elapsed = now_secs() - start;
+  std::cout << name << ": " << int64(items / elapsed) << " per sec"
+            << std::endl;
+}
+
+// Echoes n integers back doubled, as socket_server does.
+template <typename S>
+void IntegerServer(S sock, int64 n) {
+  for (int64 i = 0; i < n; i++)
+    MUST_EQ(sock.ReceiveUint64().value(), uint64(i));
+  MUST(!sock.ReceiveUint64());
+  for (int64 i = 0; i < n; i++) sock.SendUint64(i * 2);
+  sock.Shutdown(SHUT_WR);
+}
+
+template <typename S>
+void IntegerClient(S sock, int64 n) {
+  for (int64 i = 0; i < n; i++) sock.SendUint64(i);
+  sock.Shutdown(SHUT_WR);
+  for (int64 i = 0; i < n; i++)
+    MUST_EQ(sock.ReceiveUint64().value(), uint64(i * 2));
+  MUST(!sock.ReceiveUint64());
+}
+
+template <typename S>
+void StringServer(S sock, int64 n, const string& str) {
+  for (int64 i = 0; i < n; i++) MUST_EQ(sock.ReceiveString().value(), str);
+  MUST(!sock.ReceiveString());
+}
+
+template <typename S>
+void StringClient(S sock, int64 n, const string& str) {
+  for (int64 i = 0; i < n; i++) sock.SendString(str);
+  sock.Shutdown(SHUT_WR);
+}
+
+template <typename S>
+void MessageServer(S sock, int64 n,
+                   const protobuf::FileDescriptorProto& expected) {
+  protobuf::FileDescriptorProto message;
+  for (int64 i = 0; i < n; i++) {
+    MUST(sock.ReceiveMessage(message));
+    MUST_EQ(message.name().size(), expected.name().size());
+  }
+  MUST(!sock.ReceiveMessage(message));
+}
+
+template <typename S>
+void MessageClient(S sock, int64 n, const protobuf::Message& message) {
+  for (int64 i = 0; i < n; i++) sock.SendMessage(message);
+  sock.Shutdown(SHUT_WR);
+}
+
+// Sends the messages in batches of kBatch with Socket::SendMessages.
+void BatchedMessageClient(network::Socket sock, int64 n,
+                          const protobuf::Message& message) {
+  constexpr int64 kBatch = 64;
+  const std::vector<const protobuf::Message*> batch(kBatch, &message);
+  for (int64 i = 0; i < n; i += kBatch)
+    sock.SendMessages(batch.data(), std::min(kBatch, n - i));
+  sock.Shutdown(SHUT_WR);
+}
+
+network::BufferedSocket Buffered(network::Socket sock) {
+  return network::BufferedSocket(std::move(sock));
+}
+
+void Main() {
+  // The unbuffered runs do a system call per byte, so get fewer items.
+  constexpr int64 kSlowIntegers = 200'000;
+  constexpr int64 kIntegers = 20'000'000;
+  Report("Socket integers", kSlowIntegers,
+         [](network::Socket sock) {
+           IntegerServer(std::move(sock), kSlowIntegers);
+         },
+         [](network::Socket sock) {
+           IntegerClient(std::move(sock), kSlowIntegers);
+         });
+  Report("BufferedSocket integers", kIntegers,
+         [](network::Socket sock) {
+           IntegerServer(Buffered(std::move(sock)), kIntegers);
+         },
+         [](network::Socket sock) {
+           IntegerClient(Buffered(std::move(sock)), kIntegers);
+         });
+
+  for (size_t size : {16, 1024}) {
+    const string str(size, 'x');
+    const int64 slow_strings = 100'000;
+    const int64 strings = 2'000'000;
+    const string suffix = " " + std::to_string(size) + "-byte strings";
+    Report("Socket" + suffix, slow_strings,
+           [&](network::Socket sock) {
+             StringServer(std::move(sock), slow_strings, str);
+           },
+           [&](network::Socket sock) {
+             StringClient(std::move(sock), slow_strings, str);
+           });
+    Report("BufferedSocket" + suffix, strings,
+           [&](network::Socket sock) {
+             StringServer(Buffered(std::move(sock)), strings, str);
+           },
+           [&](network::Socket sock) {
+             StringClient(Buffered(std::move(sock)), strings, str);
+           });
+  }
+
+  for (size_t size : {16, 1024}) {
+    protobuf::FileDescriptorProto message;
+    message.set_name(string(size, 'x'));
+    message.ByteSizeLong();
+    const int64 slow_messages = 100'000;
+    const int64 messages = 2'000'000;
+    const string suffix = " " + std::to_string(size) + "-byte messages";
+    Report("Socket" + suffix, slow_messages,
+           [&](network::Socket sock) {
+             MessageServer(std::move(sock), slow_messages, message);
+           },
+           [&](network::Socket sock) {
+             MessageClient(std::move(sock), slow_messages, message);
+           });
+    Report("Socket::SendMessages" + suffix, messages,
+           [&](network::Socket sock) {
+             MessageServer(Buffered(std::move(sock)), messages, message);
+           },
+           [&](network::Socket sock) {
+             BatchedMessageClient(std::move(sock), messages, message);
+           });
+    Report("BufferedSocket" + suffix, messages,
+           [&](network::Socket sock) {
+             MessageServer(Buffered(std::move(sock)), messages, message);
+           },
+           [&](network::Socket sock) {
+             MessageClient(Buffered(std::move(sock)), messages, message);
+           });
+  }
+}
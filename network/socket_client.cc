@@ -1,19 +1,29 @@
+#include <iostream>
+
 #include "core/must.h"
 #include "main/noargs.h"
-#include "network/socket.h"
+#include "network/buffered_socket.h"
 
 using I = int32;
 constexpr I k = 100'000'000;
 
 void Main() {
-  network::Socket sock;
-  sock.Connect("192.168.0.17", "35358");
+  network::Socket raw_sock;
+  raw_sock.Connect("192.168.0.17", "35358");
+  network::BufferedSocket sock(std::move(raw_sock));
 
-  for (I i = 0; i < k; i++) sock.SendInteger(i);
+  const float64 start = now_secs();
+  for (I i = 0; i < k; i++) sock.SendUint64(i);
 
   sock.Shutdown(SHUT_WR);
+  const float64 sent = now_secs();
 
-  for (I i = 0; i < k; i++) MUST_EQ(sock.ReceiveInteger().value(), i * 2);
+  for (I i = 0; i < k; i++)
+    MUST_EQ(sock.ReceiveUint64().value(), uint64(i * 2));
 
-  MUST(!sock.ReceiveInteger());
+  MUST(!sock.ReceiveUint64());
+  const float64 received = now_secs();
+  std::cout << "sent " << int64(k / (sent - start))
+            << " integers/sec, received " << int64(k / (received - sent))
+            << " integers/sec" << std::endl;
 }
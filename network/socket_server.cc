@@ -1,6 +1,8 @@
+#include <iostream>
+
 #include "core/must.h"
 #include "main/noargs.h"
-#include "network/socket.h"
+#include "network/buffered_socket.h"
 
 using I = int32;
 constexpr I k = 100'000'000;
@@ -9,13 +11,19 @@ void Main() {
   network::Socket server;
   server.Bind(35358);
   server.Listen(5);
-  network::Socket sock = Accept(server);
+  network::BufferedSocket sock(Accept(server));
 
-  for (I i = 0; i < k; i++) MUST_EQ(sock.ReceiveInteger().value(), i);
+  const float64 start = now_secs();
+  for (I i = 0; i < k; i++) MUST_EQ(sock.ReceiveUint64().value(), uint64(i));
 
-  MUST(!sock.ReceiveInteger());
+  MUST(!sock.ReceiveUint64());
+  const float64 received = now_secs();
 
-  for (I i = 0; i < k; i++) sock.SendInteger(i * 2);
+  for (I i = 0; i < k; i++) sock.SendUint64(i * 2);
 
   sock.Shutdown(SHUT_WR);
+  const float64 sent = now_secs();
+  std::cout << "received " << int64(k / (received - start))
+            << " integers/sec, sent " << int64(k / (sent - received))
+            << " integers/sec" << std::endl;
 }
@@ -0,0 +1,80 @@
+#include "whee/action_cache.h"
+
+#include "core/collection_functions.h"
+#include "core/file_functions.h"
+#include "core/hex.h"
+#include "core/must.h"
+#include "core/sha3.h"
+
+namespace whee {
+
+string FileContentHash(const path& file) {
+  Sha3Context context = Sha3Context::Sha3_256();
+  HashFile(file, context);
+  std::array<uint8, 32> digest;
+  context.Final(digest.data());
+  return ByteArrayToHexString(digest);
+}
+
+ActionCache::ActionCache(const path& cache_root) : cache_root_(cache_root) {
+  create_directories(cache_root_);
+}
+
+// Files are hashed once per run, and again only if they are modified.
+string ActionCache::FileHash(const path& file) {
+  const string name = file.string();
+  const int64 mod_time = LastModificationTime(file);
+  {
+    LockGuard lock(mutex_);
+    auto* entry = FindOrNull(file_hashes_, name);
+    if (entry && entry->first == mod_time) return entry->second;
+  }
+  const string hash = FileContentHash(file);
+  LockGuard lock(mutex_);
+  file_hashes_[name] = {mod_time, hash};
+  return hash;
+}
+
+string ActionCache::Key(const string& command,
+                        const std::vector<path>& inputs) {
+  string action = command + "\n";
+  for (const path& input : inputs)
+    action += input.string() + " " + FileHash(input) + "\n";
+  return ByteArrayToHexString(SHA3_256(action));
+}
+
+path ActionCache::EntryPath(const string& key, size_t output_index) {
+  return cache_root_ / key.substr(0, 2) /
+         EncodeAsString(key, ".", output_index);
+}
+
+bool ActionCache::Restore(const string& key,
+                          const std::vector<path>& outputs) {
+  for (size_t i = 0; i < outputs.size(); i++) {
+    if (!exists(EntryPath(key, i))) {
+      misses_++;
+      return false;
+    }
+  }
+  for (size_t i = 0; i < outputs.size(); i++) {
+    remove(outputs[i]);
+    copy_file(EntryPath(key, i), outputs[i]);
+  }
+  hits_++;
+  return true;
+}
+
+// Entries are written under a temporary name and renamed into place, so a
+// concurrent or interrupted build never sees a partial entry.
+void ActionCache::Store(const string& key, const std::vector<path>& outputs) {
+  for (size_t i = 0; i < outputs.size(); i++) {
+    const path entry = EntryPath(key, i);
+    create_directories(entry.parent_path());
+    const path temporary =
+        entry.parent_path() / filesystem::unique_path("%%%%%%%%.tmp");
+    copy_file(outputs[i], temporary);
+    rename(temporary, entry);
+  }
+}
+
+}  // namespace whee
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <vector>
+
+#include "whee/paths.h"
+
+namespace whee {
+
+// The hex SHA3-256 of the contents of file, which is read in blocks rather
+// than all at once.
+string FileContentHash(const path& file);
+
+// A persistent store of build outputs under .whee/cache.  Each output is
+// keyed by a SHA3-256 of the command that produced it and of the contents of
+// every input it read, so an output is reused whenever the same command is
+// run on the same inputs, however their modification times have moved.
+// Safe to use from several jobs at once.
+class ActionCache {
+ public:
+  explicit ActionCache(const path& cache_root);
+
+  string Key(const string& command, const std::vector<path>& inputs);
+
+  // Copies the outputs cached under key into place.  Returns false if they
+  // are not all cached.
+  bool Restore(const string& key, const std::vector<path>& outputs);
+
+  void Store(const string& key, const std::vector<path>& outputs);
+
+  int64 hits() const { return hits_; }
+  int64 misses() const { return misses_; }
+
+ private:
+  string FileHash(const path& file);
+  path EntryPath(const string& key, size_t output_index);
+
+  path cache_root_;
+  Mutex mutex_;
+  std::map<string, std::pair<int64, string>> file_hashes_;
+  std::atomic<int64> hits_{0};
+  std::atomic<int64> misses_{0};
+};
+
+}  // namespace whee
@@ -0,0 +1,60 @@
+#include "whee/build_trace.h"
+
+#include <iomanip>
+#include <sstream>
+
+#include "core/file_functions.h"
+
+namespace whee {
+
+BuildTrace::BuildTrace() : epoch_(Clock::now()) {}
+
+void BuildTrace::Add(const string& name, const string& category,
+                     size_t thread, Clock::time_point start,
+                     Clock::time_point end) {
+  using secs = std::chrono::duration<float64>;
+  Event event{name, category, thread, secs(start - epoch_).count(),
+              secs(end - epoch_).count()};
+  LockGuard lock(mutex_);
+  events_.push_back(std::move(event));
+}
+
+std::vector<BuildTrace::Event> BuildTrace::events() const {
+  LockGuard lock(mutex_);
+  return events_;
+}
+
+static string JsonString(const string& s) {
+  std::ostringstream o;
+  o << '"';
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      o << '\\' << c;
+    else if (uint8(c) < 0x20)
+      o << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c)
+        << std::dec;
+    else
+      o << c;
+  }
+  o << '"';
+  return o.str();
+}
+
+void BuildTrace::Write(const path& file) const {
+  std::ostringstream o;
+  o << std::fixed << std::setprecision(0) << "{\"traceEvents\":[\n";
+  bool first = true;
+  for (const Event& event : events()) {
+    if (!first) o << ",\n";
+    first = false;
+    o << "{\"name\":" << JsonString(event.name)
+      << ",\"cat\":" << JsonString(event.category)
+      << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+      << ",\"ts\":" << event.start_secs * 1e6
+      << ",\"dur\":" << (event.end_secs - event.start_secs) * 1e6 << "}";
+  }
+  o << "\n]}\n";
+  SetFileContents(file, o.str());
+}
+
+}  // namespace whee
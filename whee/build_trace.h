@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include "whee/paths.h"
+
+namespace whee {
+
+// The timeline of a build: whee's own phases and every step it ran, with the
+// thread each ran on.  Written as a Chrome trace, which chrome://tracing and
+// Perfetto can display.  Safe to add events to from several threads.
+class BuildTrace {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Event {
+    string name;
+    string category;
+    size_t thread;
+    float64 start_secs;
+    float64 end_secs;
+  };
+
+  BuildTrace();
+
+  // Phases of whee itself run on thread 0; jobs use threads from 1 up.
+  void Add(const string& name, const string& category, size_t thread,
+           Clock::time_point start, Clock::time_point end);
+
+  // Calls function, recording it as a phase of whee named name.
+  template <typename Function>
+  auto Time(const string& name, Function function) {
+    struct Phase {
+      BuildTrace& trace;
+      const string& name;
+      Clock::time_point start;
+      ~Phase() { trace.Add(name, "whee", 0, start, Clock::now()); }
+    } phase{*this, name, Clock::now()};
+    return function();
+  }
+
+  std::vector<Event> events() const;
+
+  void Write(const path& file) const;
+
+ private:
+  Clock::time_point epoch_;
+  mutable Mutex mutex_;
+  std::vector<Event> events_;
+};
+
+}  // namespace whee
@@ -0,0 +1,149 @@
+#include "whee/job_graph.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#include "core/must.h"
+
+namespace whee {
+
+JobGraph::JobId JobGraph::Add(Action action,
+                              const std::vector<JobId>& dependencies,
+                              const string& name) {
+  const JobId id = jobs_.size();
+  jobs_.emplace_back();
+  jobs_.back().action = std::move(action);
+  jobs_.back().name = name;
+  jobs_.back().dependencies = dependencies;
+  for (JobId dependency : dependencies) {
+    MUST_LT(dependency, id);
+    jobs_[dependency].dependents.push_back(id);
+    jobs_.back().pending_dependencies++;
+  }
+  return id;
+}
+
+void JobGraph::Run(size_t nthreads, BuildTrace* trace) {
+  MUST_GT(nthreads, 0u);
+
+  Mutex mutex;
+  std::condition_variable job_finished;
+
+  // Ready jobs are started lowest id first, so with one thread the jobs run
+  // in the order they were added.
+  std::set<JobId> ready;
+  for (JobId id = 0; id < jobs_.size(); id++)
+    if (jobs_[id].pending_dependencies == 0) ready.insert(id);
+
+  size_t running = 0;
+  size_t finished = 0;
+  JobId next_to_print = 0;
+  bool failed = false;
+
+  auto print_job = [](const Job& job) {
+    std::cout << job.out;
+    std::cout.flush();
+    std::cerr << job.err;
+    std::cerr.flush();
+  };
+  auto print_finished_jobs = [&] {
+    while (next_to_print < jobs_.size() && jobs_[next_to_print].finished)
+      print_job(jobs_[next_to_print++]);
+  };
+
+  auto worker = [&](size_t thread) {
+    std::unique_lock<Mutex> lock(mutex);
+    while (true) {
+      job_finished.wait(lock, [&] {
+        return (!ready.empty() && !failed) || finished == jobs_.size() ||
+               (failed && running == 0);
+      });
+      if (ready.empty() || failed) return;
+
+      const JobId id = *ready.begin();
+      ready.erase(ready.begin());
+      running++;
+      lock.unlock();
+
+      std::ostringstream out, err;
+      std::exception_ptr error;
+      const auto start = BuildTrace::Clock::now();
+      try {
+        jobs_[id].action(out, err);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      const auto end = BuildTrace::Clock::now();
+      if (trace && !out.str().empty()) {
+        const string& name = jobs_[id].name;
+        trace->Add(name, name.substr(0, name.find(' ')), thread, start, end);
+      }
+
+      lock.lock();
+      running--;
+      finished++;
+      Job& job = jobs_[id];
+      job.finished = true;
+      job.start = start;
+      job.end = end;
+      job.out = out.str();
+      job.err = err.str();
+      job.error = error;
+      if (error) {
+        failed = true;
+      } else {
+        for (JobId dependent : job.dependents)
+          if (--jobs_[dependent].pending_dependencies == 0)
+            ready.insert(dependent);
+      }
+      print_finished_jobs();
+      job_finished.notify_all();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < nthreads; i++) threads.emplace_back(worker, i + 1);
+  for (std::thread& thread : threads) thread.join();
+
+  // After a failure, jobs that never ran leave gaps; print what did run.
+  for (JobId id = next_to_print; id < jobs_.size(); id++)
+    if (jobs_[id].finished) print_job(jobs_[id]);
+  for (const Job& job : jobs_)
+    if (job.error) std::rethrow_exception(job.error);
+}
+
+float64 JobGraph::seconds(JobId id) const {
+  return std::chrono::duration<float64>(jobs_[id].end - jobs_[id].start)
+      .count();
+}
+
+std::vector<JobGraph::JobId> JobGraph::CriticalPath() const {
+  if (jobs_.empty()) return {};
+
+  // Dependencies always have lower ids, so one pass in id order finds the
+  // longest chain ending at each job.
+  std::vector<float64> chain_secs(jobs_.size());
+  std::vector<optional<JobId>> previous(jobs_.size());
+  JobId last = 0;
+  for (JobId id = 0; id < jobs_.size(); id++) {
+    float64 longest = 0;
+    for (JobId dependency : jobs_[id].dependencies) {
+      if (!previous[id] || chain_secs[dependency] > longest) {
+        longest = chain_secs[dependency];
+        previous[id] = dependency;
+      }
+    }
+    chain_secs[id] = longest + seconds(id);
+    if (chain_secs[id] > chain_secs[last]) last = id;
+  }
+
+  std::vector<JobId> path = {last};
+  while (previous[path.back()]) path.push_back(*previous[path.back()]);
+  std::reverse(path.begin(), path.end());
+  return path;
+}
+
+}  // namespace whee
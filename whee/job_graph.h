@@ -0,0 +1,57 @@
+#pragma once
+
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include "whee/build_trace.h"
+
+namespace whee {
+
+// A set of build steps and the order they must run in.  Run executes each
+// job once all of the jobs it depends on have finished, keeping up to
+// nthreads jobs in flight.  What a job writes to its out and err streams is
+// printed in one piece, in the order the jobs were added, so the output
+// doesn't depend on the number of threads.
+class JobGraph {
+ public:
+  using JobId = size_t;
+  using Action = std::function<void(std::ostream& out, std::ostream& err)>;
+
+  // name identifies the job in traces.  Its first word is the category.
+  JobId Add(Action action, const std::vector<JobId>& dependencies = {},
+            const string& name = "");
+
+  // If a job throws, no further jobs are started, and once the running ones
+  // finish the exception of the earliest added failed job is rethrown.  If
+  // trace is given, every job that printed to out is added to it; a job that
+  // prints nothing is taken to have found nothing to do.
+  void Run(size_t nthreads, BuildTrace* trace = nullptr);
+
+  // After Run, the chain of dependent jobs with the longest total running
+  // time, which bounds how fast the build could be with unlimited threads.
+  std::vector<JobId> CriticalPath() const;
+
+  const string& name(JobId id) const { return jobs_[id].name; }
+  float64 seconds(JobId id) const;
+
+ private:
+  struct Job {
+    Action action;
+    string name;
+    std::vector<JobId> dependencies;
+    std::vector<JobId> dependents;
+    BuildTrace::Clock::time_point start;
+    BuildTrace::Clock::time_point end;
+    size_t pending_dependencies = 0;
+    bool finished = false;
+    string out;
+    string err;
+    std::exception_ptr error;
+  };
+
+  std::vector<Job> jobs_;
+};
+
+}  // namespace whee
@@ -1,6 +1,7 @@
 #include "whee/whee.h"
 
 #include <boost/algorithm/string.hpp>
+#include <iomanip>
 #include <iostream>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -11,6 +12,8 @@
 #include "core/must.h"
 #include "core/process.h"
 #include "main/args.h"
+#include "whee/action_cache.h"
+#include "whee/job_graph.h"
 #include "whee/source_file_attributes.pb.h"
 #include "whee/source_root_sentinal.h"
 #include "cm/api.h"
@@ -26,6 +29,87 @@ using boost::filesystem::path;
 
 const string source_root_sentinal = GetSourceRootSentinal();
 
+// Runs command, whose stderr is redirected to log, and copies the log to err
+// whether or not the command succeeded.
+static void ExecuteLoggedCommand(const string& command, const path& log,
+                                 std::ostream& err) {
+  optional<Error> error;
+  try {
+    ExecuteShellCommand(command);
+  } catch (const Error& e) {
+    error = e;
+  }
+
+  if (exists(log)) err << ReplaceSourceRootSentinal(GetFileContents(log));
+  if (error) {
+    throw * error;
+  }
+}
+
+// Brings outputs up to date, either by restoring them from cache or by
+// running command on inputs and caching the result.  Returns whether they
+// were restored.
+static bool ExecuteCachedCommand(ActionCache& cache, const string& command,
+                                 const std::vector<path>& inputs,
+                                 const std::vector<path>& outputs,
+                                 const path& log, std::ostream& err) {
+  const string key = cache.Key(command, inputs);
+  if (cache.Restore(key, outputs)) return true;
+  ExecuteLoggedCommand(command, log, err);
+  cache.Store(key, outputs);
+  return false;
+}
+
+// Returns the prerequisites listed in a depfile written by the compiler's
+// -MMD option.
+static std::vector<path> ReadDepFile(const path& depfile) {
+  const string contents = GetFileContents(depfile);
+  std::vector<path> prerequisites;
+  string word;
+  bool seen_target = false;
+  auto end_word = [&] {
+    if (word.empty()) return;
+    if (seen_target)
+      prerequisites.push_back(word);
+    else if (word.back() == ':')
+      seen_target = true;
+    word.clear();
+  };
+  for (size_t i = 0; i < contents.size(); i++) {
+    const char c = contents[i];
+    if (c == '\\' && i + 1 < contents.size() &&
+        (contents[i + 1] == ' ' || contents[i + 1] == '\n')) {
+      if (contents[++i] == ' ')
+        word += ' ';
+      else
+        end_word();
+    } else if (c == ' ' || c == '\t' || c == '\n') {
+      end_word();
+    } else {
+      word += c;
+    }
+  }
+  end_word();
+  return prerequisites;
+}
+
+// An object is stale if it is older than any header or source that its last
+// compile actually read.  Before it has been compiled with a depfile, it is
+// stale if it is older than fallback_last_write_time.
+static bool ObjectIsStale(const path& object, const path& depfile,
+                          int64 fallback_last_write_time) {
+  if (!exists(object)) return true;
+  const int64 object_last_write_time = LastModificationTime(object);
+  if (!exists(depfile))
+    return object_last_write_time <= fallback_last_write_time;
+  for (const path& prerequisite : ReadDepFile(depfile)) {
+    if (!exists(prerequisite) ||
+        LastModificationTime(prerequisite) >= object_last_write_time)
+      return true;
+  }
+  return false;
+}
+
 void Whee::Main(std::vector<string> args) {
   if (args.empty()) {
     args.push_back("help");
@@ -61,8 +145,9 @@ Subcommands:
 
  - whee help: this message
  - whee init <dir>: Sets up dir as a source tree root.
- - whee tidy: tidies up the source tree.
- - whee build: builds the source tree.
+ - whee tidy [-j N]: tidies up the source tree using up to N threads.
+ - whee build [-j N]: builds the source tree, running up to N steps at once.
+   A Chrome trace of the build is written to .whee/trace.json.
 )";
 
   static constexpr char helptext_init[] = R"(
@@ -97,17 +182,37 @@ void Whee::Init(const std::vector<string>& args) {
   SetFileContents(whee_dir / "lock", "");
 }
 
-void Whee::TidyFile(const path& p) {
-  int64 mod_time = LastModificationTime(p);
-  SourceFileAttributes attributes;
-
-  GetFileAttribute(p, "user.srcfile", attributes);
-  if (attributes.last_tidy() != mod_time) {
-    if (file_size(p) < 500'000) {
-      ExecuteShellCommand("clang-format-3.6 -style=Google -i ", p);
+// Formats those of files that have changed since they were last tidied, with
+// one clang-format invocation.  A file whose contents match what was last
+// tidied only has its recorded modification time updated.
+void Whee::TidyFiles(const std::vector<path>& files) {
+  std::vector<path> to_format;
+  std::vector<SourceFileAttributes> to_format_attributes;
+  for (const path& p : files) {
+    SourceFileAttributes attributes;
+    GetFileAttribute(p, "user.srcfile", attributes);
+    const int64 mod_time = LastModificationTime(p);
+    if (attributes.last_tidy() == mod_time) continue;
+    if (file_size(p) < 500'000 &&
+        attributes.tidy_hash() != FileContentHash(p)) {
+      to_format.push_back(p);
+      to_format_attributes.push_back(attributes);
+    } else {
+      attributes.set_last_tidy(mod_time);
+      SetFileAttribute(p, "user.srcfile", attributes);
     }
-    attributes.set_last_tidy(LastModificationTime(p));
-    SetFileAttribute(p, "user.srcfile", attributes);
+  }
+  if (to_format.empty()) return;
+
+  string command = "clang-format-3.6 -style=Google -i";
+  for (const path& p : to_format) command += EncodeAsString(" ", p);
+  ExecuteShellCommand(command);
+
+  for (size_t i = 0; i < to_format.size(); i++) {
+    SourceFileAttributes& attributes = to_format_attributes[i];
+    attributes.set_last_tidy(LastModificationTime(to_format[i]));
+    attributes.set_tidy_hash(FileContentHash(to_format[i]));
+    SetFileAttribute(to_format[i], "user.srcfile", attributes);
   }
 }
 
@@ -126,17 +231,51 @@ void Whee::ForEachSourcePath(
   }
 }
 
+// Parses the [-j N] option of subcommand, defaulting to one job per core.
+static size_t ParseJobs(const string& subcommand,
+                        const std::vector<string>& args) {
+  const string usage = "Usage: whee " + subcommand + " [-j N]";
+  size_t jobs = std::max(1u, std::thread::hardware_concurrency());
+  for (size_t i = 0; i < args.size(); i++) {
+    string jobs_arg;
+    if (args[i] == "-j" && i + 1 < args.size())
+      jobs_arg = args[++i];
+    else if (args[i].substr(0, 2) == "-j")
+      jobs_arg = args[i].substr(2);
+    else
+      FAIL(usage);
+    jobs = std::stoul(jobs_arg);
+    MUST_GT(jobs, 0u, usage);
+  }
+  return jobs;
+}
+
 void Whee::Tidy(const std::vector<string>& args) {
+  const size_t jobs = ParseJobs("tidy", args);
   paths = GetPaths();
   FileLock l(paths.whee / "lock");
-  MUST(args.empty());
 
+  std::vector<path> files;
   ForEachSourcePath([&](const path& source_path) {
     const path extension = source_path.extension();
     if (extension == ".h" || extension == ".cc" || extension == ".c") {
-      TidyFile(source_path);
+      files.push_back(source_path);
     }
   });
+
+  // Files are split into batches, so that each clang-format invocation
+  // handles several files while every thread still gets a share.
+  constexpr size_t kMaxBatchSize = 64;
+  const size_t batch_size =
+      std::max<size_t>(1, std::min(kMaxBatchSize, files.size() / jobs));
+  JobGraph graph;
+  for (size_t begin = 0; begin < files.size(); begin += batch_size) {
+    const std::vector<path> batch(
+        files.begin() + begin,
+        files.begin() + std::min(files.size(), begin + batch_size));
+    graph.Add([=](std::ostream& out, std::ostream& err) { TidyFiles(batch); });
+  }
+  graph.Run(jobs);
 }
 
 static RuleProto::Kind RuleNameToRuleKind(string_view rule_name) {
@@ -153,13 +292,11 @@ static RuleProto::Kind RuleNameToRuleKind(string_view rule_name) {
   }
 }
 
-static Values AddRule(std::vector<RuleProto>& rules, string_view rule_name,
-                      const Values& args) {
-  if (args.size() != 1) Throw("expected 1 argument");
+static void AddRule(std::vector<RuleProto>& rules, string_view rule_name,
+                    const Value& rule) {
   rules.emplace_back();
-  TableToProto(args.at(0), rules.back());
+  TableToProto(rule, rules.back());
   rules.back().set_kind(RuleNameToRuleKind(rule_name));
-  return {};
 }
 
 static std::vector<RuleProto> ParseRulesFile(
@@ -171,58 +308,106 @@ static std::vector<RuleProto> ParseRulesFile(
   std::vector<RuleProto> rules;
   for (string_view rule_name : {"test", "library", "program", "proto"})
     Global().insert(rule_name,
-                    MakeFunction([&, rule_name](const Values& args) -> Values {
-                      return AddRule(rules, rule_name, args);
+                    MakeFunction([&, rule_name](const Value& rule) {
+                      AddRule(rules, rule_name, rule);
                     }));
   add_rules({});
   return rules;
 }
 
-SourceTree Whee::GetSourceTree() {
-  SourceTree source_tree;
-
-  const string source_root_string = paths.root.string() + "/";
-  const size_t source_root_strlen = source_root_string.size();
-  ForEachSourcePath([&](const path& source_path) {
-    if (!is_regular_file(source_path)) return;
-    const path directory_path = canonical(source_path.parent_path());
-    string directory = directory_path.string();
-    if (directory + "/" == source_root_string) {
-      directory = "";
-    } else {
-      MUST_EQ(source_root_string, directory.substr(0, source_root_strlen),
-              directory);
-      directory = directory.substr(source_root_strlen);
-    }
-    if (source_path.filename() == "RULES.cm") {
-      std::vector<RuleProto> rule_protos = ParseRulesFile(source_path);
-
-      for (const RuleProto& rule_proto : rule_protos) {
-        Rule rule;
-        rule.proto = rule_proto;
-
-        for (const string& dependency : rule.proto.dependencies()) {
-          MUST(!dependency.empty());
-          RuleRef rule_ref;
-          if (dependency[0] == '/') {
-            size_t pos = dependency.find_last_of("/");
-            if (pos == 0) {
-              rule_ref.directory = "";
-            } else {
-              rule_ref.directory = dependency.substr(1, pos - 1);
-            }
-            rule_ref.name = dependency.substr(pos + 1);
-          } else {
-            rule_ref.directory = directory;
-            rule_ref.name = dependency;
-          }
-          rule.dependencies.push_back(rule_ref);
+static void AddRules(const string& directory,
+                     const protobuf::RepeatedPtrField<RuleProto>& protos,
+                     SourceTree& source_tree) {
+  for (const RuleProto& rule_proto : protos) {
+    Rule rule;
+    rule.proto = rule_proto;
+
+    for (const string& dependency : rule.proto.dependencies()) {
+      MUST(!dependency.empty());
+      RuleRef rule_ref;
+      if (dependency[0] == '/') {
+        size_t pos = dependency.find_last_of("/");
+        if (pos == 0) {
+          rule_ref.directory = "";
+        } else {
+          rule_ref.directory = dependency.substr(1, pos - 1);
         }
+        rule_ref.name = dependency.substr(pos + 1);
+      } else {
+        rule_ref.directory = directory;
+        rule_ref.name = dependency;
+      }
+      rule.dependencies.push_back(rule_ref);
+    }
+
+    Insert(source_tree[directory].rules, rule.proto.name(), rule);
+  }
+}
+
+static bool DirectoriesUnchanged(const RulesCache& cache) {
+  if (cache.directories_size() == 0) return false;
+  for (const RulesCache::Directory& directory : cache.directories()) {
+    if (!is_directory(directory.path()) ||
+        LastModificationTime(directory.path()) != directory.last_modified())
+      return false;
+  }
+  return true;
+}
 
-        Insert(source_tree[directory].rules, rule.proto.name(), rule);
+SourceTree Whee::GetSourceTree(RulesCache& cache, bool& changed) {
+  std::vector<string> rules_directories;
+  if (DirectoriesUnchanged(cache)) {
+    for (const RulesCache::RulesFile& rules_file : cache.rules_files())
+      rules_directories.push_back(rules_file.directory());
+  } else {
+    cache.clear_directories();
+    const string source_root_string = paths.root.string() + "/";
+    const size_t source_root_strlen = source_root_string.size();
+    ForEachSourcePath([&](const path& source_path) {
+      if (is_directory(source_path)) {
+        RulesCache::Directory* directory = cache.add_directories();
+        directory->set_path(source_path.string());
+        directory->set_last_modified(LastModificationTime(source_path));
       }
+      if (!is_regular_file(source_path)) return;
+      if (source_path.filename() != "RULES.cm") return;
+      const path directory_path = canonical(source_path.parent_path());
+      string directory = directory_path.string();
+      if (directory + "/" == source_root_string) {
+        directory = "";
+      } else {
+        MUST_EQ(source_root_string, directory.substr(0, source_root_strlen),
+                directory);
+        directory = directory.substr(source_root_strlen);
+      }
+      rules_directories.push_back(directory);
+    });
+    std::sort(rules_directories.begin(), rules_directories.end());
+  }
+
+  std::map<string, const RulesCache::RulesFile*> cached_rules_files;
+  for (const RulesCache::RulesFile& rules_file : cache.rules_files())
+    cached_rules_files[rules_file.directory()] = &rules_file;
+  if (cached_rules_files.size() != rules_directories.size()) changed = true;
+
+  SourceTree source_tree;
+  protobuf::RepeatedPtrField<RulesCache::RulesFile> rules_files;
+  for (const string& directory : rules_directories) {
+    const path rules_file_path = paths.root / directory / "RULES.cm";
+    RulesCache::RulesFile* rules_file = rules_files.Add();
+    rules_file->set_directory(directory);
+    rules_file->set_last_modified(LastModificationTime(rules_file_path));
+    auto* cached = FindOrNull(cached_rules_files, directory);
+    if (cached && (*cached)->last_modified() == rules_file->last_modified()) {
+      *rules_file->mutable_rules() = (*cached)->rules();
+    } else {
+      changed = true;
+      for (RuleProto& rule_proto : ParseRulesFile(rules_file_path))
+        *rules_file->add_rules() = std::move(rule_proto);
     }
-  });
+    AddRules(directory, rules_file->rules(), source_tree);
+  }
+  cache.mutable_rules_files()->Swap(&rules_files);
   return source_tree;
 }
 
@@ -249,8 +434,9 @@ string Whee::CompileCommand(const Platform& platform, const path& source,
   return EncodeAsString(
       platform.tool_prefix(), "g++ -c -g -std=gnu++14 -Wall -Werror -O3 ",
       platform.flags(), " ", boost::algorithm::join(include_paths_strings, " "),
-      " -include ", primitives_header.string(), " -o ", object.string(), " ",
-      source.string(), " 2> ", object.string(), ".stderr");
+      " -include ", primitives_header.string(), " -MMD -MF ", object.string(),
+      ".d -o ", object.string(), " ", source.string(), " 2> ", object.string(),
+      ".stderr");
 }
 
 string Whee::LibraryCommand(const Platform& platform, const path& library,
@@ -299,28 +485,20 @@ RuleDeps Whee::ResolveRuleDeps(const SourceTree& source_tree) {
       std::set<RuleRef> deps;
       deps.insert(me);
       if (rule.proto.kind() != RuleProto::PROTO) deps.insert(primitives_rule);
-      bool deps_added;
-      do {
-        deps_added = false;
-        std::set<RuleRef> deps_to_add;
-        for (const RuleRef& inner : deps) {
-          MUST(ContainsKey(source_tree, inner.directory) &&
-                   ContainsKey(source_tree.at(inner.directory).rules,
-                               inner.name),
-               "bad rule ref: ", inner.directory, "/", inner.name);
-          const Rule& inner_rule =
-              source_tree.at(inner.directory).rules.at(inner.name);
-          for (const RuleRef& outer : inner_rule.dependencies) {
-            if (!Contains(deps, outer)) {
-              deps_added = true;
-              deps_to_add.insert(outer);
-            }
-          }
-        }
-        for (const RuleRef& dep_to_add : deps_to_add) {
-          deps.insert(dep_to_add);
+      std::vector<RuleRef> pending(deps.begin(), deps.end());
+      while (!pending.empty()) {
+        const RuleRef inner = pending.back();
+        pending.pop_back();
+        MUST(ContainsKey(source_tree, inner.directory) &&
+                 ContainsKey(source_tree.at(inner.directory).rules,
+                             inner.name),
+             "bad rule ref: ", inner.directory, "/", inner.name);
+        const Rule& inner_rule =
+            source_tree.at(inner.directory).rules.at(inner.name);
+        for (const RuleRef& outer : inner_rule.dependencies) {
+          if (deps.insert(outer).second) pending.push_back(outer);
         }
-      } while (deps_added);
+      }
 
       ruledeps[me] = deps;
     }
@@ -358,7 +536,10 @@ void Whee::HardLinkProtoFiles(const SourceTree& source_tree,
 
 void Whee::GenProtoFiles(const SourceTree& source_tree,
                          const path& protos_superroot, const path& pb_root,
-                         const std::map<RuleRef, std::set<RuleRef>>& ruledeps) {
+                         const std::map<RuleRef, std::set<RuleRef>>& ruledeps,
+                         size_t jobs, BuildTrace& trace) {
+  JobGraph graph;
+
   for (const auto& directory_kv : source_tree) {
     const string& directory_name = directory_kv.first;
     const SourceDirectory& directory = directory_kv.second;
@@ -404,26 +585,19 @@ void Whee::GenProtoFiles(const SourceTree& source_tree,
         if (!exists(pb_header) || !exists(pb_source) ||
             LastModificationTime(pb_header) <= protos_last_write_time ||
             LastModificationTime(pb_source) <= protos_last_write_time) {
-          optional<Error> error;
-          try {
-            std::cout << " [PROTO] " << directory_name << "/" << source_file
-                      << std::endl;
-            ExecuteShellCommand(
-                GenProtoCommand(source, pb_root, include_paths, pb_stderr));
-          } catch (const Error& e) {
-            error = e;
-          }
-
-          string stderr = GetFileContents(pb_stderr);
-          std::cerr << ReplaceSourceRootSentinal(stderr);
-          std::cerr.flush();
-          if (error) {
-            throw * error;
-          }
+          const string command =
+              GenProtoCommand(source, pb_root, include_paths, pb_stderr);
+          graph.Add([=](std::ostream& out, std::ostream& err) {
+            out << " [PROTO] " << directory_name << "/" << source_file
+                << std::endl;
+            ExecuteLoggedCommand(command, pb_stderr, err);
+          }, {}, "PROTO " + directory_name + "/" + source_file);
         }
       }
     }
   }
+
+  graph.Run(jobs, &trace);
 }
 
 void Whee::HardLinkSourceFiles(const SourceTree& source_tree,
@@ -518,12 +692,10 @@ void Whee::HardLinkSourceFiles(const SourceTree& source_tree,
 //  return result;
 //}
 
-static Values AddPlatform(std::vector<Platform>& platforms,
-                          const Values& args) {
-  if (args.size() != 1) Throw("expected 1 argument");
+static void AddPlatform(std::vector<Platform>& platforms,
+                        const Value& platform) {
   platforms.emplace_back();
-  TableToProto(args.at(0), platforms.back());
-  return {};
+  TableToProto(platform, platforms.back());
 }
 
 static std::vector<Platform> ParsePlatformsFile(
@@ -533,26 +705,105 @@ static std::vector<Platform> ParsePlatformsFile(
 
   std::vector<Platform> platforms;
   Value add_platforms = Compile(GetFileContents(platforms_file));
-  Global().insert("add_platform",
-                  MakeFunction([&](const Values& args) -> Values {
-                    return AddPlatform(platforms, args);
+  Global().insert("add_platform", MakeFunction([&](const Value& platform) {
+                    AddPlatform(platforms, platform);
                   }));
   add_platforms({});
   return platforms;
 }
 
+// Prints the slowest compiles and the critical path of a build that did some
+// work.
+static void PrintBuildSummary(const BuildTrace& trace, const JobGraph& graph) {
+  std::vector<BuildTrace::Event> compiles;
+  bool ran_jobs = false;
+  for (const BuildTrace::Event& event : trace.events()) {
+    if (event.category != "whee") ran_jobs = true;
+    if (event.category == "CC") compiles.push_back(event);
+  }
+  if (!ran_jobs) return;
+
+  auto secs = [](float64 s) {
+    std::ostringstream o;
+    o << std::fixed << std::setprecision(2) << s << "s";
+    return o.str();
+  };
+
+  constexpr size_t kSlowestCompiles = 10;
+  std::sort(compiles.begin(), compiles.end(),
+            [](const BuildTrace::Event& a, const BuildTrace::Event& b) {
+              return a.end_secs - a.start_secs > b.end_secs - b.start_secs;
+            });
+  if (compiles.size() > kSlowestCompiles) compiles.resize(kSlowestCompiles);
+  if (!compiles.empty()) std::cout << "Slowest compiles:" << std::endl;
+  for (const BuildTrace::Event& compile : compiles) {
+    std::cout << "  " << secs(compile.end_secs - compile.start_secs) << " "
+              << compile.name << std::endl;
+  }
+
+  const std::vector<JobGraph::JobId> critical_path = graph.CriticalPath();
+  float64 critical_secs = 0;
+  for (JobGraph::JobId id : critical_path) critical_secs += graph.seconds(id);
+  std::cout << "Critical path: " << secs(critical_secs) << std::endl;
+  for (JobGraph::JobId id : critical_path) {
+    std::cout << "  " << secs(graph.seconds(id)) << " " << graph.name(id)
+              << std::endl;
+  }
+}
+
+static void RuleRefToProto(const RuleRef& rule_ref, RuleRefProto& proto) {
+  proto.set_directory(rule_ref.directory);
+  proto.set_name(rule_ref.name);
+}
+
+static RuleRef ProtoToRuleRef(const RuleRefProto& proto) {
+  return RuleRef(proto.directory(), proto.name());
+}
+
 void Whee::Build(const std::vector<string>& args) {
+  const size_t jobs = ParseJobs("build", args);
+
   paths = GetPaths();
 
   SetEnv("SOURCE_ROOT", paths.root.string());
 
   FileLock l(paths.whee / "lock");
 
+  BuildTrace trace;
+
   std::vector<Platform> platforms =
       ParsePlatformsFile(paths.root / "CONFIG.cm");
-  const SourceTree source_tree = GetSourceTree();
+  const path rules_cache_file = paths.whee / "rules_cache";
+  const string old_rules_cache =
+      exists(rules_cache_file) ? GetFileContents(rules_cache_file) : "";
+  RulesCache rules_cache;
+  if (!rules_cache.ParseFromString(old_rules_cache)) rules_cache.Clear();
+  bool rules_changed = false;
+  const SourceTree source_tree = trace.Time("GetSourceTree", [&] {
+    return GetSourceTree(rules_cache, rules_changed);
+  });
 
-  std::map<RuleRef, std::set<RuleRef>> ruledeps = ResolveRuleDeps(source_tree);
+  RuleDeps ruledeps;
+  if (rules_changed || rules_cache.rule_deps_size() == 0) {
+    ruledeps = trace.Time("ResolveRuleDeps",
+                          [&] { return ResolveRuleDeps(source_tree); });
+    rules_cache.clear_rule_deps();
+    for (const auto& ruledeps_kv : ruledeps) {
+      RulesCache::RuleDeps* rule_deps = rules_cache.add_rule_deps();
+      RuleRefToProto(ruledeps_kv.first, *rule_deps->mutable_rule());
+      for (const RuleRef& dep : ruledeps_kv.second)
+        RuleRefToProto(dep, *rule_deps->add_deps());
+    }
+  } else {
+    for (const RulesCache::RuleDeps& rule_deps : rules_cache.rule_deps()) {
+      std::set<RuleRef>& deps = ruledeps[ProtoToRuleRef(rule_deps.rule())];
+      for (const RuleRefProto& dep : rule_deps.deps())
+        deps.insert(ProtoToRuleRef(dep));
+    }
+  }
+  const string new_rules_cache = rules_cache.SerializeAsString();
+  if (new_rules_cache != old_rules_cache)
+    SetFileContents(rules_cache_file, new_rules_cache);
 
   const path primitives_header = canonical(paths.root / "primitives.h");
 
@@ -561,17 +812,32 @@ void Whee::Build(const std::vector<string>& args) {
   const path headers_superroot = paths.whee / "headers";
   const path units_superroot = paths.whee / "units";
 
-  HardLinkProtoFiles(source_tree, protos_superroot);
+  trace.Time("HardLinkProtoFiles", [&] {
+    HardLinkProtoFiles(source_tree, protos_superroot);
+  });
+
+  trace.Time("GenProtoFiles", [&] {
+    GenProtoFiles(source_tree, protos_superroot, pb_root, ruledeps, jobs,
+                  trace);
+  });
 
-  GenProtoFiles(source_tree, protos_superroot, pb_root, ruledeps);
+  trace.Time("HardLinkSourceFiles", [&] {
+    HardLinkSourceFiles(source_tree, pb_root, headers_superroot,
+                        units_superroot);
+  });
 
-  HardLinkSourceFiles(source_tree, pb_root, headers_superroot, units_superroot);
+  // Each step below becomes a job that runs once the jobs producing its
+  // inputs are done.  Whether a step is stale is decided when it runs, as
+  // its inputs may have just been rebuilt.
+  JobGraph graph;
+  ActionCache cache(paths.whee / "cache");
 
   for (const Platform& platform : platforms) {
     const path build_root = paths.whee / "build" / platform.name();
     const path programs_root = paths.whee / "programs" / platform.name();
 
     std::map<RuleRef, path> library_files;
+    std::map<RuleRef, JobGraph::JobId> library_jobs;
 
     for (const auto& directory_kv : source_tree) {
       const string& directory_name = directory_kv.first;
@@ -595,6 +861,7 @@ void Whee::Build(const std::vector<string>& args) {
             units_superroot / directory_name / rule_name / source_root_sentinal;
 
         std::vector<path> include_paths;
+        std::vector<path> header_inputs = {primitives_header};
         int64 source_last_write_time = 0;
 
         for (const string& unit_name : rule.cc_sources()) {
@@ -611,56 +878,65 @@ void Whee::Build(const std::vector<string>& args) {
           const SourceDirectory& dep_directory = source_tree.at(dep.directory);
           const Rule& dep_rule = dep_directory.rules.at(dep.name);
           for (const string& header_name : dep_rule.cc_headers()) {
-            int64 header_last_write_time = LastModificationTime(
-                dep_headers_root / dep.directory / header_name);
+            const path header = dep_headers_root / dep.directory / header_name;
+            header_inputs.push_back(header);
+            int64 header_last_write_time = LastModificationTime(header);
             if (header_last_write_time > source_last_write_time)
               source_last_write_time = header_last_write_time;
           }
         }
 
         std::vector<path> objects;
+        std::vector<JobGraph::JobId> compile_jobs;
         for (const string& source_file : rule.cc_sources()) {
           const path source = units_root / directory_name / source_file;
           const path object = build_directory / (source.stem().string() + ".o");
-          if (!exists(object) ||
-              LastModificationTime(object) <= source_last_write_time) {
-            optional<Error> error;
-            try {
-              std::cout << " [CC] " << platform.name() << " " << directory_name
-                        << "/" << source_file << std::endl;
-              ExecuteShellCommand(CompileCommand(
-                  platform, source, object, primitives_header, include_paths));
-            } catch (const Error& e) {
-              error = e;
+          const string command = CompileCommand(
+              platform, source, object, primitives_header, include_paths);
+          const path depfile = object.string() + ".d";
+          std::vector<path> inputs = header_inputs;
+          inputs.push_back(source);
+          compile_jobs.push_back(graph.Add([=, &cache](std::ostream& out,
+                                                       std::ostream& err) {
+            if (ObjectIsStale(object, depfile, source_last_write_time)) {
+              const bool cached = ExecuteCachedCommand(
+                  cache, command, inputs, {object, depfile},
+                  object.string() + ".stderr", err);
+              out << " [CC] " << platform.name() << " " << directory_name
+                  << "/" << source_file << (cached ? " (cached)" : "")
+                  << std::endl;
             }
-
-            string stderr = GetFileContents(object.string() + ".stderr");
-            std::cerr << ReplaceSourceRootSentinal(stderr);
-            std::cerr.flush();
-            if (error) {
-              throw * error;
-            }
-          }
+          }, {}, "CC " + platform.name() + " " + directory_name + "/" +
+                     source_file));
           objects.push_back(object);
         }
 
         if (!objects.empty()) {
-          int64 objects_last_write_time = 0;
-          for (const path& object : objects) {
-            int64 object_last_write_time = LastModificationTime(object);
-            if (object_last_write_time > objects_last_write_time) {
-              objects_last_write_time = object_last_write_time;
-            }
-          }
           const path library = build_directory / (rule_name + ".a");
-          if (!exists(library) ||
-              LastModificationTime(library) <= objects_last_write_time) {
-            remove(library);
-
-            std::cout << " [AR] " << platform.name() << " " << directory_name
-                      << "/" << rule_name << std::endl;
-            ExecuteShellCommand(LibraryCommand(platform, library, objects));
-          }
+          const string command = LibraryCommand(platform, library, objects);
+          library_jobs[me] = graph.Add([=, &cache](std::ostream& out,
+                                                   std::ostream& err) {
+            int64 objects_last_write_time = 0;
+            for (const path& object : objects) {
+              int64 object_last_write_time = LastModificationTime(object);
+              if (object_last_write_time > objects_last_write_time) {
+                objects_last_write_time = object_last_write_time;
+              }
+            }
+            if (!exists(library) ||
+                LastModificationTime(library) <= objects_last_write_time) {
+              remove(library);
+
+              const bool cached = ExecuteCachedCommand(
+                  cache,
+                  EncodeAsString(command, " 2> ", library.string(), ".stderr"),
+                  objects, {library}, library.string() + ".stderr", err);
+              out << " [AR] " << platform.name() << " " << directory_name
+                  << "/" << rule_name << (cached ? " (cached)" : "")
+                  << std::endl;
+            }
+          }, compile_jobs, "AR " + platform.name() + " " + directory_name +
+                               "/" + rule_name);
           library_files[me] = library;
         }
       }
@@ -689,59 +965,88 @@ void Whee::Build(const std::vector<string>& args) {
         const path program = programs_directory / rule_name;
 
         std::set<path> libs;
+        std::vector<JobGraph::JobId> lib_jobs;
         for (const RuleRef& dep : ruledeps.at(me)) {
           auto* p = FindOrNull(library_files, dep);
-          if (p) libs.insert(*p);
+          if (p) {
+            libs.insert(*p);
+            lib_jobs.push_back(library_jobs.at(dep));
+          }
         }
 
-        int64 libs_last_write_time = 0;
-        for (const path& lib : libs) {
-          const int64 lib_last_write_time = LastModificationTime(lib);
-          if (lib_last_write_time > libs_last_write_time) {
-            libs_last_write_time = lib_last_write_time;
+        std::vector<string> flags;
+        flags.push_back("-Wl,--no-whole-archive");
+        bool whole_archive = false;
+        for (const RuleRef& dep : ruledeps.at(me)) {
+          const Rule& dep_rule =
+              source_tree.at(dep.directory).rules.at(dep.name);
+          for (const string& syslib : dep_rule.proto.syslibs()) {
+            if (dep_rule.proto.whole_archive() != whole_archive) {
+              whole_archive = dep_rule.proto.whole_archive();
+              flags.push_back(whole_archive ? "-Wl,--whole-archive"
+                                            : "-Wl,--no-whole-archive");
+            }
+            flags.push_back(syslib);
           }
         }
-        if (!exists(program) ||
-            LastModificationTime(program) <= libs_last_write_time) {
-          std::cout << " [LN] " << platform.name() << " " << directory_name
-                    << "/" << rule_name << std::endl;
-
-          std::vector<string> flags;
-          flags.push_back("-Wl,--no-whole-archive");
-          bool whole_archive = false;
-          for (const RuleRef& dep : ruledeps.at(me)) {
-            const Rule& dep_rule =
-                source_tree.at(dep.directory).rules.at(dep.name);
-            for (const string& syslib : dep_rule.proto.syslibs()) {
-              if (dep_rule.proto.whole_archive() != whole_archive) {
-                whole_archive = dep_rule.proto.whole_archive();
-                flags.push_back(whole_archive ? "-Wl,--whole-archive"
-                                              : "-Wl,--no-whole-archive");
-              }
-              flags.push_back(syslib);
+
+        const string program_command =
+            ProgramCommand(platform, program, libs, flags);
+        const std::vector<path> lib_inputs(libs.begin(), libs.end());
+        const JobGraph::JobId link_job = graph.Add([=, &cache](
+            std::ostream& out, std::ostream& err) {
+          int64 libs_last_write_time = 0;
+          for (const path& lib : libs) {
+            const int64 lib_last_write_time = LastModificationTime(lib);
+            if (lib_last_write_time > libs_last_write_time) {
+              libs_last_write_time = lib_last_write_time;
             }
           }
+          if (!exists(program) ||
+              LastModificationTime(program) <= libs_last_write_time) {
+            const bool cached = ExecuteCachedCommand(
+                cache, EncodeAsString(program_command, " 2> ",
+                                      program.string(), ".stderr"),
+                lib_inputs, {program}, program.string() + ".stderr", err);
+            out << " [LN] " << platform.name() << " " << directory_name << "/"
+                << rule_name << (cached ? " (cached)" : "") << std::endl;
+          }
+        }, lib_jobs, "LN " + platform.name() + " " + directory_name + "/" +
+                         rule_name);
 
-          string program_command =
-              ProgramCommand(platform, program, libs, flags);
-          //          LOGEXPR(program_command);
-          ExecuteShellCommand(program_command);
-        }
         if (rule.proto.kind() == RuleProto::TEST && platform.test()) {
-          int64 program_last_mod = LastModificationTime(program);
-          SourceFileAttributes attributes;
-          GetFileAttribute(program, "user.srcfile", attributes);
-          if (attributes.last_tested() != program_last_mod) {
-            std::cout << " [TEST] " << platform.name() << " " << directory_name
-                      << "/" << rule_name << std::endl;
-            ExecuteShellCommand(program.string());
-            attributes.set_last_tested(program_last_mod);
-            SetFileAttribute(program, "user.srcfile", attributes);
-          }
+          graph.Add([=](std::ostream& out, std::ostream& err) {
+            int64 program_last_mod = LastModificationTime(program);
+            SourceFileAttributes attributes;
+            GetFileAttribute(program, "user.srcfile", attributes);
+            if (attributes.last_tested() != program_last_mod) {
+              out << " [TEST] " << platform.name() << " " << directory_name
+                  << "/" << rule_name << std::endl;
+              const path test_output = program.string() + ".output";
+              ExecuteLoggedCommand(
+                  EncodeAsString(program.string(), " > ", test_output.string(),
+                                 " 2>&1"),
+                  test_output, out);
+              attributes.set_last_tested(program_last_mod);
+              SetFileAttribute(program, "user.srcfile", attributes);
+            }
+          }, {link_job}, "TEST " + platform.name() + " " + directory_name +
+                             "/" + rule_name);
         }
       }
     }
   }
+
+  trace.Time("Run", [&] { graph.Run(jobs, &trace); });
+  trace.Write(paths.whee / "trace.json");
+  PrintBuildSummary(trace, graph);
+
+  const int64 lookups = cache.hits() + cache.misses();
+  if (lookups > 0) {
+    std::cerr << "Action cache: " << cache.hits() << " hits, "
+              << cache.misses() << " misses ("
+              << 100 * cache.hits() / lookups << "% hit rate)" << std::endl;
+  }
   std::cerr << "/:1:1: Build complete." << std::endl;
 }
 
@@ -4,6 +4,7 @@
 #include <set>
 #include <vector>
 
+#include "whee/build_trace.h"
 #include "whee/paths.h"
 #include "whee/rule.pb.h"
 
@@ -89,13 +90,16 @@ class Whee {
 
   void Init(const std::vector<string>& args);
 
-  void TidyFile(const path& p);
+  void TidyFiles(const std::vector<path>& files);
 
   void ForEachSourcePath(std::function<void(const path&)> source_path_function);
 
   void Tidy(const std::vector<string>& args);
 
-  SourceTree GetSourceTree();
+  // Rules files that are unchanged since they were recorded in cache are not
+  // reparsed.  cache is updated to match the returned tree, and changed is
+  // set if the tree differs from the one it recorded.
+  SourceTree GetSourceTree(RulesCache& cache, bool& changed);
 
   string GenProtoCommand(const path& source, const path& pb_root,
                          const std::vector<path> include_paths,
@@ -119,7 +123,8 @@ class Whee {
 
   void GenProtoFiles(const SourceTree& source_tree,
                      const path& protos_superroot, const path& pb_root,
-                     const std::map<RuleRef, std::set<RuleRef>>& ruledeps);
+                     const std::map<RuleRef, std::set<RuleRef>>& ruledeps,
+                     size_t jobs, BuildTrace& trace);
 
   void HardLinkSourceFiles(const SourceTree& source_tree, const path& pb_root,
                            const path& headers_superroot,